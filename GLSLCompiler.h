@@ -10,8 +10,17 @@
 #include <glslang/SPIRV/GlslangToSpv.h>
 #endif
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 
 //
@@ -24,30 +33,163 @@
 // namespace to the namespace of your project
 namespace gnl
 {
+
+/**
+ * @brief hashBytes
+ * @param data
+ * @param length
+ * @param seed
+ * @return
+ *
+ * 64-bit FNV-1a hash. Used to build the keys for the
+ * compile caches. Pass a previous hash as the seed to
+ * combine multiple values into a single key.
+ */
+inline uint64_t hashBytes(const void * data, size_t length, uint64_t seed = 14695981039346656037ull)
+{
+    auto const * bytes = static_cast<unsigned char const*>(data);
+    uint64_t h = seed;
+    for(size_t i=0; i < length; i++)
+    {
+        h ^= bytes[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+inline uint64_t hashString(const std::string & s, uint64_t seed = 14695981039346656037ull)
+{
+    // include the length so that ("ab","c") and ("a","bc") do not collide
+    uint64_t length = s.size();
+    return hashBytes(s.data(), s.size(), hashBytes(&length, sizeof(length), seed));
+}
+
+/**
+ * @brief The GLSLIncludedFile struct
+ *
+ * A file which was pulled in by an #include directive
+ * and the hash of its contents at the time it was read.
+ */
+struct GLSLIncludedFile
+{
+    std::string path;
+    uint64_t    hash;
+};
+
+/**
+ * @brief The GLSLIncludeData struct
+ *
+ * The contents of a file returned by an includer backend. userData
+ * is passed back to the backend's release() function.
+ */
+struct GLSLIncludeData
+{
+    const char * data     = nullptr;
+    size_t       size     = 0;
+    void *       userData = nullptr;
+};
+
+/**
+ * @brief The GLSLDiskBackend class
+ *
+ * Reads includes from the filesystem.
+ */
+class GLSLDiskBackend
+{
+public:
+    bool open(std::string const & path, GLSLIncludeData & d) const
+    {
+        std::ifstream file(path, std::ios_base::binary | std::ios_base::ate);
+        if( !file )
+            return false;
+
+        auto length = static_cast<size_t>(file.tellg());
+        char * content = new char[ length ];
+        file.seekg(0, file.beg);
+        file.read(content, static_cast<std::streamsize>(length));
+
+        d.data     = content;
+        d.size     = length;
+        d.userData = content;
+        return true;
+    }
+
+    void release(void * userData) const
+    {
+        delete [] static_cast<char*>(userData);
+    }
+};
+
 /**
- * @brief The GLSLFileIncluder class
+ * @brief The GLSLIncluder_t class
+ *
+ * An includer which reads files through a Backend. The search rules are
+ * taken from the glslangValidator source code. The Backend is a template
+ * parameter so lookups are not virtual calls. A backend must provide:
+ *
+ *   bool open(std::string const & path, GLSLIncludeData & d) const;
+ *   void release(void * userData) const;
  *
- * This Includer is taken from the glslangValidator
- * source code. For some reason this class is not exported
- * by the library.
+ * "Local" includes (#include "file") are searched for relative to the
+ * including file and then in the directories added with
+ * pushExternalLocalDirectory(), most recently added first.
+ *
+ * System includes (#include <file>) are only searched for in the
+ * directories added with pushSystemDirectory(), in the order they
+ * were added.
+ *
+ * GLSLFileIncluder, the default includer, reads from disk. See
+ * GLSLIncluder.h for backends which read from memory or a pack archive.
  */
-class GLSLFileIncluder : public glslang::TShader::Includer
+template<typename Backend>
+class GLSLIncluder_t : public glslang::TShader::Includer
 {
 public:
-    GLSLFileIncluder() : externalLocalDirectoryCount(0) { }
+    using IncludedFile = GLSLIncludedFile;
+
+    IncludeResult* includeLocal(const char* headerName,
+                                const char* includerName,
+                                size_t inclusionDepth) override
+    {
+        auto depth = static_cast<size_t>(inclusionDepth);
+
+        // Discard popped include directories, and
+        // initialize when at parse-time first level.
+        m_directoryStack.resize( depth + m_externalCount );
+        if( depth == 1 )
+            m_directoryStack.back() = getDirectory(includerName);
+
+        // Find a directory that works, using a reverse search of the include stack.
+        for(auto it = m_directoryStack.rbegin(); it != m_directoryStack.rend(); ++it)
+        {
+            if( auto * r = open(*it, headerName) )
+            {
+                m_directoryStack.push_back( getDirectory(m_path) );
+                return r;
+            }
+        }
+        return nullptr;
+    }
 
-    virtual IncludeResult* includeLocal(const char* headerName,
-                                        const char* includerName,
-                                        size_t inclusionDepth) override
+    IncludeResult* includeSystem(const char* headerName,
+                                 const char* /*includerName*/,
+                                 size_t /*inclusionDepth*/) override
     {
-        return readLocalPath(headerName, includerName, static_cast<int>(inclusionDepth) );
+        for(auto & d : m_systemDirectories)
+        {
+            if( auto * r = open(d, headerName) )
+                return r;
+        }
+        return nullptr;
     }
 
-    virtual IncludeResult* includeSystem(const char* headerName,
-                                         const char* /*includerName*/,
-                                         size_t /*inclusionDepth*/) override
+    void releaseInclude(IncludeResult* result) override
     {
-        return readSystemPath(headerName);
+        if( result != nullptr )
+        {
+            m_backend.release(result->userData);
+            delete result;
+        }
     }
 
     // Externally set directories. E.g., from a command-line -I<dir>.
@@ -55,87 +197,539 @@ public:
     //  - All these are checked after the parse-time stack of local directories
     //    is checked.
     //  - This only applies to the "local" form of #include.
-    //  - Makes its own copy of the path.
-    virtual void pushExternalLocalDirectory(const std::string& dir)
+    void pushExternalLocalDirectory(const std::string & dir)
     {
-        directoryStack.push_back(dir);
-        externalLocalDirectoryCount = static_cast<int>(directoryStack.size());
+        m_directoryStack.push_back(dir);
+        m_externalCount = m_directoryStack.size();
     }
 
-    virtual void releaseInclude(IncludeResult* result) override
+    // Directories searched for the <system> form of #include.
+    void pushSystemDirectory(const std::string & dir)
     {
-        if (result != nullptr) {
-            delete [] static_cast<tUserDataElement*>(result->userData);
-            delete result;
+        m_systemDirectories.push_back(dir);
+    }
+
+    Backend & getBackend()
+    {
+        return m_backend;
+    }
+    Backend const & getBackend() const
+    {
+        return m_backend;
+    }
+
+    /**
+     * @brief getIncludedFiles
+     * @return
+     *
+     * Returns all the files which have been included since the
+     * last call to clearIncludedFiles()
+     */
+    std::vector<IncludedFile> const & getIncludedFiles() const
+    {
+        return m_includedFiles;
+    }
+
+    void clearIncludedFiles()
+    {
+        m_includedFiles.clear();
+    }
+
+    // Used when the includer was not called, eg: the preprocessed
+    // source came from a cache.
+    void setIncludedFiles(std::vector<IncludedFile> files)
+    {
+        m_includedFiles = std::move(files);
+    }
+
+    /**
+     * @brief getSearchPathHash
+     * @return
+     *
+     * Returns a hash of the externally set include directories
+     * and the system directories.
+     */
+    uint64_t getSearchPathHash() const
+    {
+        uint64_t h = hashBytes(nullptr, 0);
+        for(size_t i=0; i < m_externalCount; i++)
+            h = hashString(m_directoryStack[i], h);
+
+        // keep the local and system directories separate
+        h = hashString("<>", h);
+        for(auto & d : m_systemDirectories)
+            h = hashString(d, h);
+        return h;
+    }
+
+    /**
+     * @brief isUnchanged
+     * @param f
+     * @return
+     *
+     * Returns true if the file still exists and its contents
+     * hash to the same value as when it was included.
+     */
+    bool isUnchanged(IncludedFile const & f) const
+    {
+        GLSLIncludeData d;
+        if( !m_backend.open(f.path, d) )
+            return false;
+
+        bool same = hashBytes(d.data, d.size) == f.hash;
+        m_backend.release(d.userData);
+        return same;
+    }
+
+protected:
+    // Open directory/headerName through the backend and record it.
+    // The path is left in m_path.
+    IncludeResult* open(std::string const & directory, const char * headerName)
+    {
+        m_path.assign(directory);
+        m_path += '/';
+        m_path += headerName;
+        std::replace(m_path.begin(), m_path.end(), '\\', '/');
+
+        GLSLIncludeData d;
+        if( !m_backend.open(m_path, d) )
+            return nullptr;
+
+        m_includedFiles.push_back( {m_path, hashBytes(d.data, d.size)} );
+        return new IncludeResult(m_path, d.data, d.size, d.userData);
+    }
+
+    // If no path markers, return current working directory.
+    // Otherwise, strip file name and return path leading up to it.
+    static std::string getDirectory(std::string const & path)
+    {
+        size_t last = path.find_last_of("/\\");
+        return last == std::string::npos ? "." : path.substr(0, last);
+    }
+
+    Backend                   m_backend;
+    std::vector<std::string>  m_directoryStack;
+    size_t                    m_externalCount = 0;
+    std::vector<std::string>  m_systemDirectories;
+    std::vector<IncludedFile> m_includedFiles;
+    std::string               m_path; // reused to avoid allocating for every lookup
+};
+
+/**
+ * The default includer, which reads #include files from disk.
+ */
+using GLSLFileIncluder = GLSLIncluder_t<GLSLDiskBackend>;
+
+/**
+ * @brief The GLSLPreamble class
+ *
+ * An immutable, fully expanded preamble (the text which is placed
+ * before the shader source, eg: a list of #defines). The text and
+ * its hash are computed once when it is created, so the same preamble
+ * can be shared between compilers and threads without being rebuilt.
+ *
+ * auto preamble = gnl::GLSLPreamble::create({ {"USE_SHADOWS",""}, {"MAX_LIGHTS","8"} });
+ * compiler.setPreamble(preamble);
+ */
+class GLSLPreamble
+{
+public:
+    using Definition = std::pair<std::string, std::string>;
+
+    explicit GLSLPreamble(std::string text) : m_text(std::move(text)), m_hash(hashString(m_text))
+    {
+    }
+
+    /**
+     * @brief expand
+     * @param definitions
+     * @return
+     *
+     * Returns the preamble text for a list of definitions:
+     *
+     * #define VAR VALUE
+     */
+    static std::string expand(std::vector<Definition> const & definitions)
+    {
+        size_t length = 0;
+        for(auto & d : definitions)
+            length += d.first.size() + d.second.size() + 10;
+
+        std::string text;
+        text.reserve(length);
+        for(auto & d : definitions)
+        {
+            text += "#define ";
+            text += d.first;
+            text += ' ';
+            text += d.second;
+            text += '\n';
         }
+        return text;
     }
 
-    virtual ~GLSLFileIncluder() override { }
+    static std::shared_ptr<const GLSLPreamble> create(std::vector<Definition> const & definitions)
+    {
+        return std::make_shared<const GLSLPreamble>(expand(definitions));
+    }
+
+    /**
+     * @brief hashDefinitions
+     * @param definitions
+     * @return
+     *
+     * Returns hashString(expand(definitions)) without building the text.
+     */
+    static uint64_t hashDefinitions(std::vector<Definition> const & definitions)
+    {
+        static const char define[] = "#define ";
+
+        uint64_t length = 0;
+        for(auto & d : definitions)
+            length += sizeof(define) - 1 + d.first.size() + 1 + d.second.size() + 1;
+
+        const char space   = ' ';
+        const char newline = '\n';
+
+        uint64_t h = hashBytes(&length, sizeof(length));
+        for(auto & d : definitions)
+        {
+            h = hashBytes(define, sizeof(define) - 1, h);
+            h = hashBytes(d.first.data(), d.first.size(), h);
+            h = hashBytes(&space, 1, h);
+            h = hashBytes(d.second.data(), d.second.size(), h);
+            h = hashBytes(&newline, 1, h);
+        }
+        return h;
+    }
+
+    /**
+     * @brief equals
+     * @param definitions
+     * @return
+     *
+     * Returns true if the text is expand(definitions), without building it.
+     */
+    bool equals(std::vector<Definition> const & definitions) const
+    {
+        size_t i = 0;
+        auto match = [&](const char * data, size_t size)
+        {
+            if( m_text.compare(i, size, data, size) != 0 )
+                return false;
+            i += size;
+            return true;
+        };
+
+        for(auto & d : definitions)
+        {
+            if( !match("#define ", 8) || !match(d.first.data(), d.first.size()) || !match(" ", 1) ||
+                !match(d.second.data(), d.second.size()) || !match("\n", 1) )
+                return false;
+        }
+        return i == m_text.size();
+    }
+
+    std::string const & str() const
+    {
+        return m_text;
+    }
+
+    const char* c_str() const
+    {
+        return m_text.c_str();
+    }
+
+    uint64_t hash() const
+    {
+        return m_hash;
+    }
 
 protected:
-    typedef char tUserDataElement;
-    std::vector<std::string> directoryStack;
-    int externalLocalDirectoryCount;
+    friend class GLSLPreamblePool;
 
-    // Search for a valid "local" path based on combining the stack of include
-    // directories and the nominal name of the header.
-    virtual IncludeResult* readLocalPath(const char* headerName, const char* includerName, int depth)
+    // used by GLSLPreamblePool, which has already hashed the text
+    GLSLPreamble(std::string text, uint64_t hash) : m_text(std::move(text)), m_hash(hash)
     {
-        // Discard popped include directories, and
-        // initialize when at parse-time first level.
-        directoryStack.resize( static_cast<size_t>(depth + externalLocalDirectoryCount) );
-        if (depth == 1)
-            directoryStack.back() = getDirectory(includerName);
+    }
 
-        // Find a directory that works, using a reverse search of the include stack.
-        for (auto it = directoryStack.rbegin(); it != directoryStack.rend(); ++it) {
-            std::string path = *it + '/' + headerName;
-            std::replace(path.begin(), path.end(), '\\', '/');
-            std::ifstream file(path, std::ios_base::binary | std::ios_base::ate);
-            if (file)
+    std::string m_text;
+    uint64_t    m_hash;
+};
+
+/**
+ * @brief The GLSLPreamblePool class
+ *
+ * Interns preambles so that identical sets of definitions
+ * share a single GLSLPreamble. It is thread safe.
+ *
+ * gnl::GLSLPreamblePool pool;
+ * auto a = pool.intern({ {"MAX_LIGHTS","8"} });
+ * auto b = pool.intern({ {"MAX_LIGHTS","8"} }); // a == b
+ */
+class GLSLPreamblePool
+{
+public:
+    // The text is only expanded if the preamble is not in the pool
+    std::shared_ptr<const GLSLPreamble> intern(std::vector<GLSLPreamble::Definition> const & definitions)
+    {
+        auto h = GLSLPreamble::hashDefinitions(definitions);
+
+        std::lock_guard<std::mutex> L(m_mutex);
+        auto & bucket = m_preambles[h];
+        for(auto & p : bucket)
+        {
+            if( p->equals(definitions) )
+                return p;
+        }
+        bucket.push_back( std::shared_ptr<const GLSLPreamble>( new GLSLPreamble(GLSLPreamble::expand(definitions), h) ) );
+        return bucket.back();
+    }
+
+    std::shared_ptr<const GLSLPreamble> intern(std::string text)
+    {
+        auto h = hashString(text);
+
+        std::lock_guard<std::mutex> L(m_mutex);
+        auto & bucket = m_preambles[h];
+        for(auto & p : bucket)
+        {
+            if( p->str() == text )
+                return p;
+        }
+        bucket.push_back( std::shared_ptr<const GLSLPreamble>( new GLSLPreamble(std::move(text), h) ) );
+        return bucket.back();
+    }
+
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> L(m_mutex);
+        size_t count = 0;
+        for(auto & b : m_preambles)
+            count += b.second.size();
+        return count;
+    }
+
+    void clear()
+    {
+        std::lock_guard<std::mutex> L(m_mutex);
+        m_preambles.clear();
+    }
+
+protected:
+    mutable std::mutex                                                                 m_mutex;
+    std::unordered_map<uint64_t, std::vector< std::shared_ptr<const GLSLPreamble> > > m_preambles;
+};
+
+/**
+ * @brief The GLSLPreprocessedCache class
+ *
+ * Stores fully preprocessed translation units so that repeated
+ * compiles of the same source/preamble/includes can skip the
+ * glslang preprocessing stage and go straight to parsing.
+ *
+ * Validation only re-checks the files which were actually included.
+ * A header which is newly added to a directory earlier in the search
+ * path, and which would now shadow an included file, does not
+ * invalidate an entry. Call clear() after changing include directories.
+ *
+ * The preprocessed output does not depend on the target
+ * Vulkan/SPIR-V versions, so a single cache can be shared
+ * between all the GLSLCompiler_t variants. It is thread safe.
+ *
+ * auto cache = std::make_shared<gnl::GLSLPreprocessedCache>();
+ * compiler.setPreprocessedCache(cache);
+ */
+class GLSLPreprocessedCache
+{
+public:
+    using IncludedFile = GLSLIncludedFile;
+
+    struct Entry
+    {
+        std::string               preprocessedGLSL;
+        std::vector<IncludedFile> includedFiles;
+        std::chrono::nanoseconds  preprocessTime{0};
+    };
+
+    struct Stats
+    {
+        size_t                   hits        = 0;
+        size_t                   misses      = 0;
+        size_t                   invalidated = 0; // entries discarded because an included file changed
+        std::chrono::nanoseconds preprocessTime{0}; // time spent preprocessing on misses
+        std::chrono::nanoseconds savedTime{0};      // preprocessing time skipped by hits
+    };
+
+    /**
+     * @brief find
+     * @param key
+     * @param isUnchanged - callable, bool(IncludedFile const&)
+     * @return
+     *
+     * Returns the cached entry or nullptr. An entry is only returned
+     * if isUnchanged() returns true for all of its included files,
+     * otherwise it is removed from the cache.
+     */
+    template<typename Validator>
+    std::shared_ptr<const Entry> find(uint64_t key, Validator && isUnchanged)
+    {
+        std::shared_ptr<const Entry> entry;
+        {
+            std::lock_guard<std::mutex> L(m_mutex);
+            auto it = m_entries.find(key);
+            if( it == m_entries.end() )
             {
-                directoryStack.push_back(getDirectory(path));
-                return newIncludeResult(path, file, static_cast<int>(file.tellg()) );
+                m_stats.misses++;
+                return nullptr;
             }
+            entry = it->second;
         }
 
-        return nullptr;
+        // validate outside of the lock, this may touch the filesystem
+        for(auto & f : entry->includedFiles)
+        {
+            if( !isUnchanged(f) )
+            {
+                std::lock_guard<std::mutex> L(m_mutex);
+                auto it = m_entries.find(key);
+                if( it != m_entries.end() && it->second == entry )
+                    m_entries.erase(it);
+                m_stats.invalidated++;
+                m_stats.misses++;
+                return nullptr;
+            }
+        }
+
+        std::lock_guard<std::mutex> L(m_mutex);
+        m_stats.hits++;
+        m_stats.savedTime += entry->preprocessTime;
+        return entry;
     }
 
-    // Search for a valid <system> path.
-    // Not implemented yet; returning nullptr signals failure to find.
-    virtual IncludeResult* readSystemPath(const char* /*headerName*/) const
+    void insert(uint64_t key, std::shared_ptr<const Entry> entry)
     {
-        return nullptr;
+        std::lock_guard<std::mutex> L(m_mutex);
+        m_stats.preprocessTime += entry->preprocessTime;
+        m_entries[key] = std::move(entry);
     }
 
-    // Do actual reading of the file, filling in a new include result.
-    virtual IncludeResult* newIncludeResult(const std::string& path, std::ifstream& file, int length) const
+    Stats getStats() const
     {
-        char* content = new tUserDataElement [ length ];
-        file.seekg(0, file.beg);
-        file.read(content, length);
-        return new IncludeResult(path, content, static_cast<size_t>(length), content);
+        std::lock_guard<std::mutex> L(m_mutex);
+        return m_stats;
     }
 
-    // If no path markers, return current working directory.
-    // Otherwise, strip file name and return path leading up to it.
-    virtual std::string getDirectory(const std::string path) const
+    size_t size() const
     {
-        size_t last = path.find_last_of("/\\");
-        return last == std::string::npos ? "." : path.substr(0, last);
+        std::lock_guard<std::mutex> L(m_mutex);
+        return m_entries.size();
+    }
+
+    void clear()
+    {
+        std::lock_guard<std::mutex> L(m_mutex);
+        m_entries.clear();
+        m_stats = Stats();
     }
+
+protected:
+    mutable std::mutex                                           m_mutex;
+    std::unordered_map<uint64_t, std::shared_ptr<const Entry> > m_entries;
+    Stats                                                        m_stats;
 };
 
+/**
+ * @brief The GLSLSpirvCache class
+ *
+ * Interface for caches of compiled SPIR-V. The keys are built by
+ * the compiler from the preprocessed source, the preamble, the shader
+ * stage, the target versions and the built-in resources.
+ *
+ * See GLSLSharedCache.h for a cache which can be shared between
+ * multiple processes.
+ */
+class GLSLSpirvCache
+{
+public:
+    virtual ~GLSLSpirvCache() = default;
 
+    // Returns true and fills spirv if the key exists in the cache
+    virtual bool load(uint64_t key, std::vector<uint32_t> & spirv) = 0;
+
+    virtual void store(uint64_t key, std::vector<uint32_t> const & spirv) = 0;
+
+    // Called after a miss, before the shader is compiled. The returned object
+    // is held until the result has been stored. Implementations can use this
+    // to stop multiple compilers from compiling the same shader at the same time.
+    // load() is called again once the lock has been acquired, so the returned
+    // object must be non-null if a lock was taken and null otherwise.
+    virtual std::shared_ptr<void> lock(uint64_t /*key*/)
+    {
+        return nullptr;
+    }
+};
+
+/**
+ * @brief The GLSLCompileProfiler class
+ *
+ * Interface which is notified of the stages of each compile.
+ * See GLSLProfiler.h for a profiler which attributes compile
+ * time to include files and functions.
+ */
+class GLSLCompileProfiler
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    virtual ~GLSLCompileProfiler() = default;
+
+    virtual void beginCompile(EShLanguage /*stage*/)
+    {
+    }
+
+    // Returns the includer to use when preprocessing. Profilers can
+    // wrap the compiler's includer to time each included file.
+    virtual glslang::TShader::Includer & wrapIncluder(glslang::TShader::Includer & includer)
+    {
+        return includer;
+    }
+
+    // Called after each stage: "preprocess", "parse", "link" and "spirv".
+    // If the preprocessed source came from a GLSLPreprocessedCache, the
+    // includer is not wrapped and "preprocess (cached)" is reported instead.
+    virtual void stage(const char * /*name*/, clock::time_point /*begin*/, clock::time_point /*end*/)
+    {
+    }
+
+    // Called after the program has been linked, before it is converted to SPIR-V
+    virtual void linked(glslang::TProgram & /*program*/, EShLanguage /*stage*/)
+    {
+    }
+
+    // Called when the compile succeeds, including when the result came from a cache
+    virtual void endCompile(std::vector<unsigned int> const & /*spirv*/)
+    {
+    }
+};
+
+/**
+ * The Includer_t is used to resolve #include directives. See GLSLIncluder.h
+ * for includers which read from memory or from a pack archive.
+ */
 template<glslang::EShTargetClientVersion VulkanClientVersion = glslang::EShTargetVulkan_1_0,
-         glslang::EShTargetLanguageVersion TargetVersion     = glslang::EShTargetSpv_1_0>
+         glslang::EShTargetLanguageVersion TargetVersion     = glslang::EShTargetSpv_1_0,
+         typename Includer_t                                 = GLSLFileIncluder>
 class GLSLCompiler_t
 {
-    GLSLFileIncluder m_includer;
+    Includer_t       m_includer;
     std::string      m_log;
     std::string      m_debug;
-    std::string      m_preamble;
+    std::string      m_preambleText; // definitions added since m_preamble was built
+    std::shared_ptr<const GLSLPreamble> m_preamble;
+    std::shared_ptr<GLSLPreprocessedCache> m_preprocessedCache;
+    std::shared_ptr<GLSLSpirvCache>        m_spirvCache;
+    std::shared_ptr<GLSLCompileProfiler>   m_profiler;
 public:
 
     /**
@@ -154,7 +748,41 @@ public:
      */
     void addCompleTimeDefinition( const std::string var, const std::string value="")
     {
-        m_preamble += "#define " + var + ' ' + value + '\n';
+        if( m_preamble )
+        {
+            m_preambleText = m_preamble->str();
+            m_preamble.reset();
+        }
+        m_preambleText += "#define " + var + ' ' + value + '\n';
+    }
+
+    /**
+     * @brief setPreamble
+     * @param preamble
+     *
+     * Replaces the preamble, including any definitions added with
+     * addCompleTimeDefinition(). The preamble is shared, not copied.
+     */
+    void setPreamble( std::shared_ptr<const GLSLPreamble> preamble)
+    {
+        m_preambleText.clear();
+        m_preamble = std::move(preamble);
+    }
+
+    /**
+     * @brief getPreamble
+     * @return
+     *
+     * Returns the current preamble.
+     */
+    std::shared_ptr<const GLSLPreamble> const & getPreamble()
+    {
+        if( !m_preamble )
+        {
+            m_preamble = std::make_shared<const GLSLPreamble>( std::move(m_preambleText) );
+            m_preambleText.clear();
+        }
+        return m_preamble;
     }
     std::string const& getLog() const
     {
@@ -169,6 +797,94 @@ public:
         m_includer.pushExternalLocalDirectory(path);
     }
 
+    /**
+     * @brief addSystemIncludePath
+     * @param path
+     *
+     * Adds a directory to search for #include <file>
+     */
+    void addSystemIncludePath( const std::string & path)
+    {
+        m_includer.pushSystemDirectory(path);
+    }
+
+    Includer_t & getIncluder()
+    {
+        return m_includer;
+    }
+
+    /**
+     * @brief setPreprocessedCache
+     * @param cache
+     *
+     * Use a cache of preprocessed sources. The cache can be shared
+     * between multiple compilers. Set to nullptr to disable.
+     */
+    void setPreprocessedCache( std::shared_ptr<GLSLPreprocessedCache> cache)
+    {
+        m_preprocessedCache = std::move(cache);
+    }
+    std::shared_ptr<GLSLPreprocessedCache> const & getPreprocessedCache() const
+    {
+        return m_preprocessedCache;
+    }
+
+    /**
+     * @brief setSpirvCache
+     * @param cache
+     *
+     * Use a cache of compiled SPIR-V. Set to nullptr to disable.
+     */
+    void setSpirvCache( std::shared_ptr<GLSLSpirvCache> cache)
+    {
+        m_spirvCache = std::move(cache);
+    }
+    std::shared_ptr<GLSLSpirvCache> const & getSpirvCache() const
+    {
+        return m_spirvCache;
+    }
+
+    /**
+     * @brief setProfiler
+     * @param profiler
+     *
+     * Notify a profiler of every compile. Set to nullptr to disable.
+     */
+    void setProfiler( std::shared_ptr<GLSLCompileProfiler> profiler)
+    {
+        m_profiler = std::move(profiler);
+    }
+    std::shared_ptr<GLSLCompileProfiler> const & getProfiler() const
+    {
+        return m_profiler;
+    }
+
+    /**
+     * @brief hashResources
+     * @param Resources
+     * @param seed
+     * @return
+     *
+     * Hash the built-in resources. The members are hashed
+     * individually so that padding bytes are not included.
+     */
+    static uint64_t hashResources(TBuiltInResource const & Resources, uint64_t seed)
+    {
+        // all the members before the limits are ints
+        uint64_t h = hashBytes(&Resources, offsetof(TBuiltInResource, limits), seed);
+
+        bool const limits[] = { Resources.limits.nonInductiveForLoops,
+                                Resources.limits.whileLoops,
+                                Resources.limits.doWhileLoops,
+                                Resources.limits.generalUniformIndexing,
+                                Resources.limits.generalAttributeMatrixVectorIndexing,
+                                Resources.limits.generalVaryingIndexing,
+                                Resources.limits.generalSamplerIndexing,
+                                Resources.limits.generalVariableIndexing,
+                                Resources.limits.generalConstantMatrixVectorIndexing };
+        return hashBytes(limits, sizeof(limits), h);
+    }
+
     std::vector<unsigned int> compile(const std::string & InputGLSL, EShLanguage ShaderType)
     {
         auto resources = getDefaultTBuiltInResource();
@@ -181,11 +897,17 @@ public:
         m_log.clear();
         m_debug.clear();
 
+        if( m_profiler )
+            m_profiler->beginCompile(ShaderType);
+
         const char* InputCString = InputGLSL.c_str();
 
         glslang::TShader Shader(ShaderType);
 
-        Shader.setPreamble(m_preamble.data());
+        // hold a reference to the preamble while compiling
+        auto Preamble = getPreamble();
+
+        Shader.setPreamble(Preamble->c_str());
         Shader.setStrings(&InputCString, 1);
 
         //Set up Vulkan/SpirV Environment
@@ -200,18 +922,107 @@ public:
         const int DefaultVersion = 100;
 
 #if 1
-        std::string PreprocessedGLSL;
+        std::shared_ptr<const GLSLPreprocessedCache::Entry> Preprocessed;
+        uint64_t PreprocessedKey = 0;
 
-        if (!Shader.preprocess(&Resources, DefaultVersion, ENoProfile, false, false, messages, &PreprocessedGLSL, m_includer))
+        if( m_preprocessedCache )
         {
-            m_log   = Shader.getInfoLog();
-            m_debug = Shader.getInfoDebugLog();
-            throw std::runtime_error( m_log );
+            PreprocessedKey = hashString(InputGLSL, Preamble->hash());
+            PreprocessedKey = hashBytes(&ShaderType, sizeof(ShaderType), PreprocessedKey);
+            PreprocessedKey = hashBytes(&messages, sizeof(messages), PreprocessedKey);
+            PreprocessedKey = hashBytes(&DefaultVersion, sizeof(DefaultVersion), PreprocessedKey);
+            auto searchPathHash = m_includer.getSearchPathHash();
+            PreprocessedKey = hashBytes(&searchPathHash, sizeof(searchPathHash), PreprocessedKey);
+
+            Preprocessed = m_preprocessedCache->find(PreprocessedKey,
+                                                     [this](GLSLPreprocessedCache::IncludedFile const & f)
+                                                     {
+                                                         return m_includer.isUnchanged(f);
+                                                     });
         }
 
-        const char* PreprocessedCStr = PreprocessedGLSL.c_str();
+        if( !Preprocessed )
+        {
+            auto Entry = std::make_shared<GLSLPreprocessedCache::Entry>();
+
+            m_includer.clearIncludedFiles();
+            auto t0 = std::chrono::steady_clock::now();
+
+            glslang::TShader::Includer & Includer = m_profiler ? m_profiler->wrapIncluder(m_includer) : m_includer;
+
+            if (!Shader.preprocess(&Resources, DefaultVersion, ENoProfile, false, false, messages, &Entry->preprocessedGLSL, Includer))
+            {
+                m_log   = Shader.getInfoLog();
+                m_debug = Shader.getInfoDebugLog();
+                throw std::runtime_error( m_log );
+            }
+
+            auto t1 = std::chrono::steady_clock::now();
+            if( m_profiler )
+                m_profiler->stage("preprocess", t0, t1);
+
+            Entry->preprocessTime = std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0);
+            Entry->includedFiles  = m_includer.getIncludedFiles();
+
+            if( m_preprocessedCache )
+                m_preprocessedCache->insert(PreprocessedKey, Entry);
+
+            Preprocessed = std::move(Entry);
+        }
+
+        else
+        {
+            // the includer was not called, report the files from the cache
+            m_includer.setIncludedFiles(Preprocessed->includedFiles);
+
+            if( m_profiler )
+            {
+                auto now = std::chrono::steady_clock::now();
+                m_profiler->stage("preprocess (cached)", now, now);
+            }
+        }
+
+        const char* PreprocessedCStr = Preprocessed->preprocessedGLSL.c_str();
         Shader.setStrings(&PreprocessedCStr, 1);
 #endif
+        std::vector<unsigned int> SpirV;
+        std::shared_ptr<void>     SpirvCacheLock;
+        uint64_t                  SpirvKey = 0;
+
+        if( m_spirvCache )
+        {
+            auto vulkanVersion = VulkanClientVersion;
+            auto targetVersion = TargetVersion;
+            auto generator     = glslang::GetSpirvGeneratorVersion();
+
+            SpirvKey = hashString(Preprocessed->preprocessedGLSL, Preamble->hash());
+            SpirvKey = hashBytes(&ShaderType, sizeof(ShaderType), SpirvKey);
+            SpirvKey = hashBytes(&messages, sizeof(messages), SpirvKey);
+            SpirvKey = hashBytes(&DefaultVersion, sizeof(DefaultVersion), SpirvKey);
+            SpirvKey = hashBytes(&vulkanVersion, sizeof(vulkanVersion), SpirvKey);
+            SpirvKey = hashBytes(&targetVersion, sizeof(targetVersion), SpirvKey);
+            SpirvKey = hashBytes(&generator, sizeof(generator), SpirvKey);
+            SpirvKey = hashResources(Resources, SpirvKey);
+
+            bool found = m_spirvCache->load(SpirvKey, SpirV);
+
+            // someone else may have compiled it while we were waiting for the lock
+            if( !found )
+            {
+                SpirvCacheLock = m_spirvCache->lock(SpirvKey);
+                found = SpirvCacheLock && m_spirvCache->load(SpirvKey, SpirV);
+            }
+
+            if( found )
+            {
+                if( m_profiler )
+                    m_profiler->endCompile(SpirV);
+                return SpirV;
+            }
+        }
+
+        auto parseBegin = std::chrono::steady_clock::now();
+
         if (!Shader.parse(&Resources, DefaultVersion, false, messages))
         {
             m_log   = Shader.getInfoLog();
@@ -220,6 +1031,10 @@ public:
             throw std::runtime_error( m_log );
         }
 
+        auto linkBegin = std::chrono::steady_clock::now();
+        if( m_profiler )
+            m_profiler->stage("parse", parseBegin, linkBegin);
+
         glslang::TProgram Program;
         Program.addShader(&Shader);
 
@@ -231,6 +1046,14 @@ public:
             throw std::runtime_error( "Linking Failed" );
         }
 
+        auto spirvBegin = std::chrono::steady_clock::now();
+        if( m_profiler )
+        {
+            m_profiler->stage("link", linkBegin, spirvBegin);
+            m_profiler->linked(Program, ShaderType);
+            spirvBegin = std::chrono::steady_clock::now();
+        }
+
         // if (!Program.mapIO())
         // {
         //      m_log   = Shader.getInfoLog();
@@ -240,7 +1063,6 @@ public:
         // 	std::cout << Shader.getInfoDebugLog() << std::endl;
         // }
 
-        std::vector<unsigned int> SpirV;
         spv::SpvBuildLogger logger;
         glslang::SpvOptions spvOptions;
 
@@ -251,6 +1073,17 @@ public:
             m_log = logger.getAllMessages();
         }
 
+        if( m_profiler )
+        {
+            m_profiler->stage("spirv", spirvBegin, std::chrono::steady_clock::now());
+            m_profiler->endCompile(SpirV);
+        }
+
+        if( m_spirvCache )
+        {
+            m_spirvCache->store(SpirvKey, SpirV);
+        }
+
         return SpirV;
     }
 
@@ -262,7 +1095,10 @@ public:
      */
     static TBuiltInResource getDefaultTBuiltInResource()
     {
-        TBuiltInResource DefaultTBuiltInResource;
+        // value-initialized so that members which are not set below (they
+        // differ between glslang versions) are zero, they are part of the
+        // SPIR-V cache key
+        TBuiltInResource DefaultTBuiltInResource{};
 
         DefaultTBuiltInResource.maxLights                                   = 32;
         DefaultTBuiltInResource.maxClipPlanes                               = 6;
@@ -373,12 +1209,38 @@ public:
         return s.substr(i);
     }
 
+    /**
+     * @brief shaderStageFromName
+     * @param name
+     * @return
+     *
+     * Returns the shader stage for a file extension or stage name.
+     * The leading '.' is optional, eg: ".vert", "vert", "frag", "comp"
+     */
+    static EShLanguage shaderStageFromName(std::string const & name)
+    {
+        auto n = !name.empty() && name.front() == '.' ? name.substr(1) : name;
+
+        if( n == "vert")
+            return EShLangVertex;
+        else if( n == "frag")
+            return EShLangFragment;
+        else if( n == "comp")
+            return EShLangCompute;
+        else if( n == "tesc")
+            return EShLangTessControl;
+        else if( n == "tese")
+            return EShLangTessEvaluation;
+        else if( n == "geom")
+            return EShLangGeometry;
+
+        throw  std::runtime_error("Could not determine shader language, files must have extensions: vert, frag, comp, tesc, tese, geom.");
+    }
+
     static std::vector<uint32_t> compileFromFile(std::string const &P, std::vector<std::string> const & includePaths = {})
     {
         GLSLCompiler_t compiler;
 
-        auto ext = extension(P);//P.extension();
-
         compiler.addIncludePath( parentPath(P) );
         for(auto & ii : includePaths)
         {
@@ -392,31 +1254,7 @@ public:
             std::string srcString((std::istreambuf_iterator<char>(t)),
                              std::istreambuf_iterator<char>());
 
-            if( ext == ".vert")
-            {
-                return compiler.compile( srcString, EShLangVertex);
-            }
-            else if( ext == ".frag")
-            {
-                return compiler.compile( srcString, EShLangFragment);
-            }
-            else if( ext == ".comp")
-            {
-                return compiler.compile( srcString, EShLangCompute);
-            }
-            else if( ext == ".tesc")
-            {
-                return compiler.compile( srcString, EShLangTessControl);
-            }
-            else if( ext == ".tese")
-            {
-                return compiler.compile( srcString, EShLangTessEvaluation);
-            }
-            else if( ext == ".geom")
-            {
-                return compiler.compile( srcString, EShLangGeometry);
-            }
-            throw  std::runtime_error("Could not determine shader language, files must have extensions: vert, frag, comp, tesc, tese, geom.");
+            return compiler.compile( srcString, shaderStageFromName( extension(P) ) );
         }
         throw  std::runtime_error("Error opening file.");
     }
@@ -0,0 +1,340 @@
+#ifndef HEADER_ONLY_GLSLCOMPILER_INCLUDER_H
+#define HEADER_ONLY_GLSLCOMPILER_INCLUDER_H
+
+#include "GLSLCompiler.h"
+
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <unordered_map>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define GNL_GLSL_HAS_MMAP 1
+#endif
+
+// When including this header in your projects: change the
+// namespace to the namespace of your project
+namespace gnl
+{
+
+/**
+ * @brief normalizeIncludePath
+ * @param path
+ * @param out
+ *
+ * Converts '\' to '/', and removes empty and '.' segments and
+ * resolves '..' segments where possible so that the same file
+ * always maps to the same name. The result is written to out,
+ * which can be reused between calls to avoid allocating.
+ *
+ * eg: "./include/../include//getcolor.glsl" -> "include/getcolor.glsl"
+ */
+inline void normalizeIncludePath(std::string const & path, std::string & out)
+{
+    bool absolute = !path.empty() && (path.front() == '/' || path.front() == '\\');
+    out.assign(absolute ? "/" : "");
+
+    // start of the last segment in out
+    size_t root = out.size();
+
+    size_t i = 0;
+    while( i <= path.size() )
+    {
+        auto j = path.find_first_of("/\\", i);
+        if( j == std::string::npos )
+            j = path.size();
+
+        auto length = j - i;
+        bool dot    = length == 1 && path[i] == '.';
+        bool dotdot = length == 2 && path[i] == '.' && path[i+1] == '.';
+
+        auto last = out.find_last_of('/');
+        last = (last == std::string::npos || last < root) ? root : last + 1;
+
+        if( dotdot && out.size() > root && out.compare(last, std::string::npos, "..") != 0 )
+        {
+            // remove the last segment and the separator before it
+            out.resize( last > root ? last - 1 : root );
+        }
+        else if( length > 0 && !dot )
+        {
+            if( out.size() > root )
+                out += '/';
+            out.append(path, i, length);
+        }
+
+        i = j + 1;
+    }
+}
+
+inline std::string normalizeIncludePath(std::string const & path)
+{
+    std::string out;
+    normalizeIncludePath(path, out);
+    return out;
+}
+
+/**
+ * @brief The GLSLMemoryBackend class
+ *
+ * Reads includes from an in-memory map of path -> contents. Files must
+ * be added before compiling, the contents are not copied when included.
+ *
+ * The paths are normalized, so "include/common.glsl" can be found using
+ * the include directory "include" or "./include".
+ */
+class GLSLMemoryBackend
+{
+public:
+    void addFile(std::string const & path, std::string contents)
+    {
+        m_files[ normalizeIncludePath(path) ] = std::move(contents);
+    }
+
+    /**
+     * @brief addDirectory
+     * @param directory
+     * @param virtualDirectory
+     *
+     * Recursively adds all the files in a directory on disk. The files
+     * are added relative to virtualDirectory.
+     */
+    void addDirectory(std::string const & directory, std::string const & virtualDirectory = "")
+    {
+        for(auto & f : std::filesystem::recursive_directory_iterator(directory))
+        {
+            if( !f.is_regular_file() )
+                continue;
+
+            std::ifstream in(f.path(), std::ios_base::binary);
+            std::string   contents((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+            auto relative = std::filesystem::relative(f.path(), directory).generic_string();
+            addFile( virtualDirectory.empty() ? relative : virtualDirectory + '/' + relative, std::move(contents));
+        }
+    }
+
+    std::unordered_map<std::string, std::string> const & getFiles() const
+    {
+        return m_files;
+    }
+
+    bool open(std::string const & path, GLSLIncludeData & d) const
+    {
+        normalizeIncludePath(path, m_key);
+        auto it = m_files.find(m_key);
+        if( it == m_files.end() )
+            return false;
+
+        d.data     = it->second.data();
+        d.size     = it->second.size();
+        d.userData = nullptr;
+        return true;
+    }
+
+    void release(void *) const
+    {
+    }
+
+protected:
+    std::unordered_map<std::string, std::string> m_files;
+    mutable std::string                          m_key; // reused to avoid allocating for every lookup
+};
+
+#if defined(GNL_GLSL_HAS_MMAP)
+/**
+ * @brief The GLSLPackBackend class
+ *
+ * Reads includes from a pack archive which is memory mapped. Use
+ * GLSLPackBackend::write() to create the archive. The format is:
+ *
+ *   char[8]  magic "GLSLPAK1"
+ *   uint64   number of files
+ *   for each file:
+ *       uint64 name length, uint64 offset, uint64 size, name
+ *   file contents
+ *
+ * Offsets are from the start of the archive.
+ */
+class GLSLPackBackend
+{
+public:
+    GLSLPackBackend() = default;
+    GLSLPackBackend(GLSLPackBackend const &) = delete;
+    GLSLPackBackend & operator=(GLSLPackBackend const &) = delete;
+
+    ~GLSLPackBackend()
+    {
+        close();
+    }
+
+    /**
+     * @brief load
+     * @param packPath
+     *
+     * Memory map a pack archive. Throws if the file cannot be
+     * opened or is not a valid archive.
+     */
+    void load(std::string const & packPath)
+    {
+        close();
+
+        int fd = ::open(packPath.c_str(), O_RDONLY);
+        if( fd < 0 )
+            throw std::runtime_error("Error opening pack: " + packPath);
+
+        struct stat st;
+        if( ::fstat(fd, &st) != 0 || st.st_size == 0 )
+        {
+            ::close(fd);
+            throw std::runtime_error("Error opening pack: " + packPath);
+        }
+
+        m_size = static_cast<size_t>(st.st_size);
+        void * p = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+
+        if( p == MAP_FAILED )
+        {
+            m_size = 0;
+            throw std::runtime_error("Error mapping pack: " + packPath);
+        }
+        m_data = static_cast<const char*>(p);
+
+        if( !readIndex() )
+        {
+            close();
+            throw std::runtime_error("Invalid pack: " + packPath);
+        }
+    }
+
+    /**
+     * @brief write
+     * @param packPath
+     * @param files - a container of (path, contents) pairs
+     *
+     * Writes a pack archive. Files are sorted by name so that
+     * the same set of files always produces the same archive.
+     */
+    template<typename Container>
+    static void write(std::string const & packPath, Container const & files)
+    {
+        std::map<std::string, std::string const*> sorted;
+        for(auto & f : files)
+            sorted[ normalizeIncludePath(f.first) ] = &f.second;
+
+        uint64_t offset = 16;
+        for(auto & f : sorted)
+            offset += 24 + f.first.size();
+
+        std::ofstream out(packPath, std::ios_base::binary | std::ios_base::trunc);
+        if( !out )
+            throw std::runtime_error("Error opening pack: " + packPath);
+
+        auto put = [&](uint64_t v) { out.write(reinterpret_cast<const char*>(&v), sizeof(v)); };
+
+        out.write(Magic, 8);
+        put(sorted.size());
+        for(auto & f : sorted)
+        {
+            put(f.first.size());
+            put(offset);
+            put(f.second->size());
+            out.write(f.first.data(), static_cast<std::streamsize>(f.first.size()));
+            offset += f.second->size();
+        }
+        for(auto & f : sorted)
+            out.write(f.second->data(), static_cast<std::streamsize>(f.second->size()));
+
+        if( !out )
+            throw std::runtime_error("Error writing pack: " + packPath);
+    }
+
+    bool open(std::string const & path, GLSLIncludeData & d) const
+    {
+        normalizeIncludePath(path, m_key);
+        auto it = m_index.find(m_key);
+        if( it == m_index.end() )
+            return false;
+
+        d.data     = m_data + it->second.first;
+        d.size     = it->second.second;
+        d.userData = nullptr;
+        return true;
+    }
+
+    void release(void *) const
+    {
+    }
+
+    size_t size() const
+    {
+        return m_index.size();
+    }
+
+protected:
+    static constexpr const char Magic[] = "GLSLPAK1";
+
+    void close()
+    {
+        if( m_data )
+            ::munmap(const_cast<char*>(m_data), m_size);
+        m_data = nullptr;
+        m_size = 0;
+        m_index.clear();
+    }
+
+    bool readIndex()
+    {
+        size_t pos = 0;
+        auto get = [&](uint64_t & v)
+        {
+            if( m_size - pos < sizeof(v) )
+                return false;
+            std::memcpy(&v, m_data + pos, sizeof(v));
+            pos += sizeof(v);
+            return true;
+        };
+
+        if( m_size < 16 || std::memcmp(m_data, Magic, 8) != 0 )
+            return false;
+        pos = 8;
+
+        uint64_t count;
+        if( !get(count) )
+            return false;
+
+        for(uint64_t i=0; i < count; i++)
+        {
+            uint64_t nameLength, offset, size;
+            if( !get(nameLength) || !get(offset) || !get(size) )
+                return false;
+            if( m_size - pos < nameLength || offset > m_size || m_size - offset < size )
+                return false;
+
+            m_index[ std::string(m_data + pos, nameLength) ] = { static_cast<size_t>(offset), static_cast<size_t>(size) };
+            pos += nameLength;
+        }
+        return true;
+    }
+
+    const char * m_data = nullptr;
+    size_t       m_size = 0;
+    std::unordered_map<std::string, std::pair<size_t, size_t> > m_index;
+    mutable std::string                                         m_key; // reused to avoid allocating for every lookup
+};
+#endif
+
+using GLSLDiskIncluder   = GLSLFileIncluder;
+using GLSLMemoryIncluder = GLSLIncluder_t<GLSLMemoryBackend>;
+#if defined(GNL_GLSL_HAS_MMAP)
+using GLSLPackIncluder   = GLSLIncluder_t<GLSLPackBackend>;
+#endif
+
+}
+
+#endif
@@ -0,0 +1,564 @@
+#ifndef HEADER_ONLY_GLSLCOMPILER_PROFILER_H
+#define HEADER_ONLY_GLSLCOMPILER_PROFILER_H
+
+#include "GLSLCompiler.h"
+
+#if __has_include(<glslang/MachineIndependent/localintermediate.h>)
+#include <glslang/MachineIndependent/localintermediate.h>
+#else
+#error "GLSLProfiler.h requires the glslang/MachineIndependent headers"
+#endif
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <map>
+#include <ostream>
+#include <sstream>
+#include <thread>
+
+// When including this header in your projects: change the
+// namespace to the namespace of your project
+namespace gnl
+{
+
+/**
+ * @brief The GLSLProfiler class
+ *
+ * Attributes compile time to the included files and the functions
+ * of the shaders compiled with it.
+ *
+ *  - Preprocessing time of each included file is measured from the
+ *    moment the file is requested until glslang releases it, minus
+ *    the time spent in files it includes.
+ *  - glslang parses a translation unit in a single pass, so parse time
+ *    is estimated by splitting it between the files and functions in
+ *    proportion to the number of AST nodes they produced. This relies
+ *    on the #line directives glslang writes for each included file.
+ *  - The number of SPIR-V instructions is counted for each function.
+ *
+ * The results can be printed with writeReport() or written as a Chrome
+ * trace (chrome://tracing, Perfetto, speedscope) with writeChromeTrace().
+ *
+ * A profiler may be shared by multiple compilers, but not by compilers
+ * which are compiling at the same time.
+ *
+ * auto profiler = std::make_shared<gnl::GLSLProfiler>();
+ * compiler.setProfiler(profiler);
+ * profiler->setSourceName("mesh.frag");
+ * compiler.compile(src, EShLangFragment);
+ *
+ * std::ofstream trace("trace.json");
+ * profiler->writeChromeTrace(trace);
+ */
+class GLSLProfiler : public GLSLCompileProfiler
+{
+public:
+    struct FileStats
+    {
+        size_t          includeCount = 0;   // number of times the file was included
+        size_t          astNodes     = 0;
+        clock::duration preprocessTime{0};  // measured, excluding nested includes
+        clock::duration parseTime{0};       // estimated from the number of AST nodes
+    };
+
+    struct FunctionStats
+    {
+        std::string     file;
+        size_t          definitions       = 0; // number of compiles which contained the function
+        size_t          astNodes          = 0;
+        size_t          spirvInstructions = 0;
+        clock::duration parseTime{0};          // estimated from the number of AST nodes
+    };
+
+    GLSLProfiler() : m_epoch(clock::now())
+    {
+    }
+
+    /**
+     * @brief setSourceName
+     * @param name
+     *
+     * The name used for code which is not in an included file,
+     * eg: the path of the shader being compiled.
+     */
+    void setSourceName(std::string name)
+    {
+        m_sourceName = std::move(name);
+    }
+
+    // files are keyed by the name of the include
+    std::map<std::string, FileStats> const & getFileStats() const
+    {
+        return m_files;
+    }
+
+    // functions are keyed by "<file>:<mangled name>"
+    std::map<std::string, FunctionStats> const & getFunctionStats() const
+    {
+        return m_functions;
+    }
+
+    void clear()
+    {
+        m_files.clear();
+        m_functions.clear();
+        m_events.clear();
+        m_epoch = clock::now();
+    }
+
+    void beginCompile(EShLanguage stage) override
+    {
+        m_compileBegin = clock::now();
+        m_compileStage = stage;
+        m_parseTime    = clock::duration(0);
+        m_linked       = false;
+        m_openIncludes.clear();
+        m_compileFunctions.clear();
+    }
+
+    glslang::TShader::Includer & wrapIncluder(glslang::TShader::Includer & includer) override
+    {
+        m_includeTimer.m_profiler = this;
+        m_includeTimer.m_includer = &includer;
+        return m_includeTimer;
+    }
+
+    void stage(const char * name, clock::time_point begin, clock::time_point end) override
+    {
+        if( std::string(name) == "parse" )
+        {
+            m_parseBegin = begin;
+            m_parseTime  = end - begin;
+        }
+        addEvent(name, "stage", begin, end - begin, {});
+    }
+
+    void linked(glslang::TProgram & program, EShLanguage stage) override
+    {
+        auto * intermediate = program.getIntermediate(stage);
+        if( !intermediate || !intermediate->getTreeRoot() )
+            return;
+
+        NodeCounter counter(m_sourceName);
+        intermediate->getTreeRoot()->traverse(&counter);
+
+        m_linked = true;
+
+        size_t total = 0;
+        for(auto & f : counter.fileNodes)
+            total += f.second;
+        if( total == 0 )
+            return;
+
+        auto estimate = [&](size_t nodes)
+        {
+            return std::chrono::duration_cast<clock::duration>(m_parseTime * static_cast<double>(nodes) / static_cast<double>(total));
+        };
+
+        // lay out the estimated parse time of each file inside the parse
+        // stage, with the functions defined in each file nested inside it
+        auto fileBegin = m_parseBegin;
+        for(auto & f : counter.fileNodes)
+        {
+            auto & F = m_files[f.first];
+            auto   t = estimate(f.second);
+            F.astNodes  += f.second;
+            F.parseTime += t;
+
+            addEvent(f.first, "parse (estimated)", fileBegin, t, { {"astNodes", std::to_string(f.second)} });
+
+            auto functionBegin = fileBegin;
+            for(auto & fn : counter.functions)
+            {
+                if( fn.second.file != f.first )
+                    continue;
+                auto ft = estimate(fn.second.nodes);
+                m_compileFunctions[fn.first] = { fn.second.file, fn.second.nodes, ft, functionBegin };
+                functionBegin += ft;
+            }
+            fileBegin += t;
+        }
+    }
+
+    void endCompile(std::vector<unsigned int> const & spirv) override
+    {
+        auto instructions = countSpirvInstructions(spirv);
+
+        for(auto & fn : m_compileFunctions)
+        {
+            // glslang names the entry point "main" rather than "main("
+            auto it = instructions.find(fn.first);
+            if( it == instructions.end() && fn.first.size() > 1 && fn.first.back() == '(' )
+                it = instructions.find( fn.first.substr(0, fn.first.size()-1) );
+            size_t count = it == instructions.end() ? 0 : it->second;
+
+            auto & F = m_functions[fn.second.file + ':' + fn.first];
+            F.file               = fn.second.file;
+            F.definitions       += 1;
+            F.astNodes          += fn.second.nodes;
+            F.parseTime         += fn.second.parseTime;
+            F.spirvInstructions += count;
+
+            addEvent(fn.first, "function (estimated)", fn.second.begin, fn.second.parseTime,
+                     { {"file", quote(fn.second.file)},
+                       {"astNodes", std::to_string(fn.second.nodes)},
+                       {"spirvInstructions", std::to_string(count)} });
+        }
+
+        addEvent(m_sourceName, "compile", m_compileBegin, clock::now() - m_compileBegin,
+                 { {"stage", std::to_string(static_cast<int>(m_compileStage))},
+                   {"spirvWords", std::to_string(spirv.size())},
+                   {"cached", m_linked ? "false" : "true"} });
+    }
+
+    /**
+     * @brief writeReport
+     * @param out
+     *
+     * Writes a table of the files and functions, most expensive first.
+     */
+    void writeReport(std::ostream & out) const
+    {
+        auto ms = [](clock::duration d) { return std::chrono::duration<double, std::milli>(d).count(); };
+
+        std::vector< std::pair<std::string, FileStats> > files(m_files.begin(), m_files.end());
+        std::sort(files.begin(), files.end(), [](auto & a, auto & b)
+        {
+            return a.second.preprocessTime + a.second.parseTime > b.second.preprocessTime + b.second.parseTime;
+        });
+
+        out << std::fixed << std::setprecision(3);
+        out << std::setw(14) << "preprocess ms" << std::setw(14) << "parse ms*" << std::setw(10) << "included"
+            << std::setw(10) << "nodes" << "  file\n";
+        for(auto & f : files)
+        {
+            out << std::setw(14) << ms(f.second.preprocessTime)
+                << std::setw(14) << ms(f.second.parseTime)
+                << std::setw(10) << f.second.includeCount
+                << std::setw(10) << f.second.astNodes
+                << "  " << f.first << '\n';
+        }
+
+        std::vector< std::pair<std::string, FunctionStats> > functions(m_functions.begin(), m_functions.end());
+        std::sort(functions.begin(), functions.end(), [](auto & a, auto & b)
+        {
+            return a.second.parseTime > b.second.parseTime;
+        });
+
+        out << '\n';
+        out << std::setw(14) << "parse ms*" << std::setw(10) << "compiles" << std::setw(10) << "nodes"
+            << std::setw(10) << "spirv" << "  function\n";
+        for(auto & f : functions)
+        {
+            out << std::setw(14) << ms(f.second.parseTime)
+                << std::setw(10) << f.second.definitions
+                << std::setw(10) << f.second.astNodes
+                << std::setw(10) << f.second.spirvInstructions
+                << "  " << f.first << '\n';
+        }
+        out << "\n* estimated from the number of AST nodes\n";
+    }
+
+    /**
+     * @brief writeChromeTrace
+     * @param out
+     *
+     * Writes all the recorded events in the Chrome trace event format.
+     */
+    void writeChromeTrace(std::ostream & out) const
+    {
+        auto us = [](clock::duration d) { return std::chrono::duration<double, std::micro>(d).count(); };
+
+        out << std::fixed << std::setprecision(3);
+        out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        for(size_t i=0; i < m_events.size(); i++)
+        {
+            auto & e = m_events[i];
+            out << (i == 0 ? "\n" : ",\n");
+            out << "{\"name\":" << quote(e.name)
+                << ",\"cat\":"  << quote(e.category)
+                << ",\"ph\":\"X\""
+                << ",\"ts\":"   << us(e.begin - m_epoch)
+                << ",\"dur\":"  << us(e.duration)
+                << ",\"pid\":1,\"tid\":" << e.tid
+                << ",\"args\":{";
+            for(size_t j=0; j < e.args.size(); j++)
+            {
+                out << (j == 0 ? "" : ",") << quote(e.args[j].first) << ':' << e.args[j].second;
+            }
+            out << "}}";
+        }
+        out << "\n]}\n";
+    }
+
+    /**
+     * @brief countSpirvInstructions
+     * @param spirv
+     * @return
+     *
+     * Returns the number of instructions in each function, keyed
+     * by the name given to the function by OpName.
+     */
+    static std::map<std::string, size_t> countSpirvInstructions(std::vector<unsigned int> const & spirv)
+    {
+        const uint32_t OpName        = 5;
+        const uint32_t OpFunction    = 54;
+        const uint32_t OpFunctionEnd = 56;
+
+        std::map<uint32_t, std::string> names;
+        std::map<uint32_t, size_t>      counts;
+
+        uint32_t function = 0;
+        size_t   count    = 0;
+
+        for(size_t i = 5; i < spirv.size(); )
+        {
+            uint32_t wordCount = spirv[i] >> 16;
+            uint32_t opcode    = spirv[i] & 0xffff;
+            if( wordCount == 0 || i + wordCount > spirv.size() )
+                break;
+
+            if( opcode == OpName && wordCount > 2 )
+            {
+                auto const * s = reinterpret_cast<const char*>(&spirv[i+2]);
+                names[ spirv[i+1] ] = std::string(s, strnlen(s, (wordCount-2) * sizeof(uint32_t)));
+            }
+            else if( opcode == OpFunction && wordCount > 2 )
+            {
+                function = spirv[i+2];
+                count    = 0;
+            }
+
+            if( function != 0 )
+                count++;
+
+            if( opcode == OpFunctionEnd )
+            {
+                counts[function] = count;
+                function = 0;
+            }
+
+            i += wordCount;
+        }
+
+        std::map<std::string, size_t> result;
+        for(auto & c : counts)
+        {
+            auto it = names.find(c.first);
+            result[ it == names.end() ? "%" + std::to_string(c.first) : it->second ] += c.second;
+        }
+        return result;
+    }
+
+protected:
+    struct Event
+    {
+        std::string         name;
+        std::string         category;
+        clock::time_point   begin;
+        clock::duration     duration;
+        size_t              tid;
+        std::vector< std::pair<std::string, std::string> > args; // values are JSON
+    };
+
+    struct OpenInclude
+    {
+        glslang::TShader::Includer::IncludeResult * result;
+        clock::time_point                           begin;
+        clock::duration                             children;
+    };
+
+    struct CompileFunction
+    {
+        std::string       file;
+        size_t            nodes;
+        clock::duration   parseTime;
+        clock::time_point begin;
+    };
+
+    /**
+     * Forwards all calls to the compiler's includer and
+     * times how long each include is open for.
+     */
+    class IncludeTimer : public glslang::TShader::Includer
+    {
+    public:
+        IncludeResult* includeSystem(const char* headerName, const char* includerName, size_t inclusionDepth) override
+        {
+            auto t0 = clock::now();
+            auto * r = m_includer->includeSystem(headerName, includerName, inclusionDepth);
+            if( r )
+                m_profiler->openInclude(r, t0);
+            return r;
+        }
+
+        IncludeResult* includeLocal(const char* headerName, const char* includerName, size_t inclusionDepth) override
+        {
+            auto t0 = clock::now();
+            auto * r = m_includer->includeLocal(headerName, includerName, inclusionDepth);
+            if( r )
+                m_profiler->openInclude(r, t0);
+            return r;
+        }
+
+        void releaseInclude(IncludeResult* result) override
+        {
+            if( result )
+                m_profiler->closeInclude(result, clock::now());
+            m_includer->releaseInclude(result);
+        }
+
+        GLSLProfiler *               m_profiler = nullptr;
+        glslang::TShader::Includer * m_includer = nullptr;
+    };
+
+    /**
+     * Counts the AST nodes in each file and each function definition.
+     */
+    class NodeCounter : public glslang::TIntermTraverser
+    {
+    public:
+        struct Function
+        {
+            std::string file;
+            size_t      nodes = 0;
+        };
+
+        explicit NodeCounter(std::string const & sourceName)
+            : glslang::TIntermTraverser(true, false, true),
+              m_sourceName(sourceName)
+        {
+        }
+
+        void visitSymbol(glslang::TIntermSymbol* node) override               { count(node); }
+        void visitConstantUnion(glslang::TIntermConstantUnion* node) override { count(node); }
+
+        bool visitBinary(glslang::TVisit v, glslang::TIntermBinary* node) override       { return pre(v, node); }
+        bool visitUnary(glslang::TVisit v, glslang::TIntermUnary* node) override         { return pre(v, node); }
+        bool visitSelection(glslang::TVisit v, glslang::TIntermSelection* node) override { return pre(v, node); }
+        bool visitLoop(glslang::TVisit v, glslang::TIntermLoop* node) override           { return pre(v, node); }
+        bool visitBranch(glslang::TVisit v, glslang::TIntermBranch* node) override       { return pre(v, node); }
+        bool visitSwitch(glslang::TVisit v, glslang::TIntermSwitch* node) override       { return pre(v, node); }
+
+        bool visitAggregate(glslang::TVisit v, glslang::TIntermAggregate* node) override
+        {
+            if( node->getOp() == glslang::EOpFunction )
+            {
+                if( v == glslang::EvPreVisit )
+                {
+                    m_function = node->getName().c_str();
+                    functions[m_function].file = fileOf(node);
+                }
+                else if( v == glslang::EvPostVisit )
+                {
+                    m_function.clear();
+                }
+            }
+            return pre(v, node);
+        }
+
+        std::map<std::string, size_t>   fileNodes;
+        std::map<std::string, Function> functions;
+
+    protected:
+        bool pre(glslang::TVisit v, glslang::TIntermNode* node)
+        {
+            if( v == glslang::EvPreVisit )
+                count(node);
+            return true;
+        }
+
+        void count(glslang::TIntermNode* node)
+        {
+            fileNodes[ fileOf(node) ]++;
+            if( !m_function.empty() )
+                functions[m_function].nodes++;
+        }
+
+        std::string fileOf(glslang::TIntermNode* node) const
+        {
+            auto const & loc = node->getLoc();
+            return loc.name ? std::string(loc.name->c_str()) : m_sourceName;
+        }
+
+        std::string const & m_sourceName;
+        std::string         m_function;
+    };
+
+    void openInclude(glslang::TShader::Includer::IncludeResult * r, clock::time_point begin)
+    {
+        m_openIncludes.push_back( {r, begin, clock::duration(0)} );
+    }
+
+    void closeInclude(glslang::TShader::Includer::IncludeResult * r, clock::time_point end)
+    {
+        auto it = std::find_if(m_openIncludes.rbegin(), m_openIncludes.rend(), [r](OpenInclude const & o) { return o.result == r; });
+        if( it == m_openIncludes.rend() )
+            return;
+
+        auto inclusive = end - it->begin;
+        auto self      = inclusive - it->children;
+
+        auto & F = m_files[r->headerName];
+        F.includeCount++;
+        F.preprocessTime += self;
+
+        addEvent(r->headerName, "include", it->begin, inclusive,
+                 { {"selfUs", std::to_string(std::chrono::duration<double, std::micro>(self).count())} });
+
+        m_openIncludes.erase( std::next(it).base() );
+        if( !m_openIncludes.empty() )
+            m_openIncludes.back().children += inclusive;
+    }
+
+    void addEvent(std::string name, std::string category, clock::time_point begin, clock::duration duration,
+                  std::vector< std::pair<std::string, std::string> > args)
+    {
+        auto tid = std::hash<std::thread::id>()(std::this_thread::get_id()) % 1000000;
+        m_events.push_back( {std::move(name), std::move(category), begin, duration, tid, std::move(args)} );
+    }
+
+    static std::string quote(std::string const & s)
+    {
+        std::ostringstream out;
+        out << '"';
+        for(char c : s)
+        {
+            switch(c)
+            {
+                case '"':  out << "\\\""; break;
+                case '\\': out << "\\\\"; break;
+                case '\n': out << "\\n";  break;
+                case '\t': out << "\\t";  break;
+                default:
+                    if( static_cast<unsigned char>(c) < 0x20 )
+                        out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c) << std::dec;
+                    else
+                        out << c;
+            }
+        }
+        out << '"';
+        return out.str();
+    }
+
+    clock::time_point                       m_epoch;
+    std::string                             m_sourceName = "<source>";
+    std::map<std::string, FileStats>        m_files;
+    std::map<std::string, FunctionStats>    m_functions;
+    std::vector<Event>                      m_events;
+
+    // state of the current compile
+    IncludeTimer                            m_includeTimer;
+    clock::time_point                       m_compileBegin;
+    EShLanguage                             m_compileStage = EShLangVertex;
+    clock::time_point                       m_parseBegin;
+    clock::duration                         m_parseTime{0};
+    bool                                    m_linked = false;
+    std::vector<OpenInclude>                m_openIncludes;
+    std::map<std::string, CompileFunction>  m_compileFunctions;
+};
+
+}
+
+#endif
@@ -0,0 +1,499 @@
+#ifndef HEADER_ONLY_GLSLCOMPILER_SHADER_MANIFEST_H
+#define HEADER_ONLY_GLSLCOMPILER_SHADER_MANIFEST_H
+
+#include "GLSLCompiler.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <iomanip>
+#include <sstream>
+
+// When including this header in your projects: change the
+// namespace to the namespace of your project
+namespace gnl
+{
+
+/**
+ * @brief The ShaderManifestEntry struct
+ *
+ * A single shader listed in a manifest file.
+ */
+struct ShaderManifestEntry
+{
+    size_t                   line = 0;     // line number in the manifest
+    std::string              input;        // path to the GLSL source
+    std::string              output;       // path to write the SPIR-V to
+    std::string              stage;        // stage name, eg: "vert". Empty to use the input extension
+    std::vector<std::string> includePaths;
+    std::vector< std::pair<std::string, std::string> > defines;
+
+    /**
+     * @brief key
+     * @return
+     *
+     * Returns a hash of everything which describes this entry.
+     * Used to identify entries in the resume journal.
+     */
+    uint64_t key() const
+    {
+        uint64_t h = hashString(input);
+        h = hashString(output, h);
+        h = hashString(stage, h);
+        for(auto & i : includePaths)
+            h = hashString(i, h);
+        for(auto & d : defines)
+            h = hashString(d.second, hashString(d.first, h));
+        return h;
+    }
+};
+
+/**
+ * @brief The ShaderManifestReader class
+ *
+ * Reads a shader manifest one entry at a time so that the manifest
+ * never has to be held in memory. Each non-empty line which does not
+ * start with '#' describes one shader:
+ *
+ *   <input> [stage=<vert|frag|comp|tesc|tese|geom>] [output=<path>] [define=NAME[=VALUE]]... [include=<dir>]...
+ *
+ * eg:
+ *
+ *   # forward pass
+ *   shaders/mesh.vert  output=spv/mesh.vert.spv
+ *   shaders/mesh.frag  output=spv/mesh_skinned.frag.spv define=SKINNED define=MAX_BONES=64 include=shaders/include
+ *
+ * Tokens are separated by whitespace, wrap a token in double quotes
+ * if it contains spaces: "output=my shader.spv"
+ *
+ * Relative input and include paths are relative to the directory containing
+ * the manifest. Relative output paths are relative to the output directory,
+ * which defaults to the directory containing the manifest. If the output is
+ * not given, it defaults to <input>.spv in the output directory.
+ */
+class ShaderManifestReader
+{
+public:
+    explicit ShaderManifestReader(std::string const & manifestPath, std::string const & outputDirectory = "") : m_file(manifestPath)
+    {
+        if( !m_file )
+            throw std::runtime_error("Error opening manifest: " + manifestPath);
+
+        auto i = manifestPath.find_last_of("/\\");
+        m_directory       = i == std::string::npos ? "." : manifestPath.substr(0, i);
+        m_outputDirectory = outputDirectory.empty() ? m_directory : outputDirectory;
+    }
+
+    /**
+     * @brief next
+     * @param entry
+     * @return
+     *
+     * Reads the next entry from the manifest. Returns false when
+     * the end of the manifest is reached. Throws if the line
+     * cannot be parsed.
+     */
+    bool next(ShaderManifestEntry & entry)
+    {
+        std::string line;
+        while( std::getline(m_file, line) )
+        {
+            m_line++;
+
+            std::istringstream tokens(line);
+            std::string        token;
+
+            if( !(tokens >> std::quoted(token)) || (!token.empty() && token.front() == '#') )
+                continue;
+
+            if( token.empty() )
+                throw std::runtime_error(error("empty input path"));
+
+            entry = ShaderManifestEntry();
+            entry.line  = m_line;
+            entry.input = resolve(token, m_directory);
+
+            // written relative to the output directory
+            auto defaultOutput = (isAbsolute(token) ? token.substr(token.find_last_of("/\\") + 1) : token) + ".spv";
+
+            while( tokens >> std::quoted(token) )
+            {
+                auto eq = token.find('=');
+                if( eq == std::string::npos )
+                    throw std::runtime_error(error("expected key=value, got: " + token));
+
+                auto k = token.substr(0, eq);
+                auto v = token.substr(eq+1);
+
+                if( k == "stage" )
+                {
+                    entry.stage = v;
+                }
+                else if( k == "output" )
+                {
+                    entry.output = resolve(v, m_outputDirectory);
+                }
+                else if( k == "include" )
+                {
+                    entry.includePaths.push_back( resolve(v, m_directory) );
+                }
+                else if( k == "define" )
+                {
+                    auto deq = v.find('=');
+                    if( deq == std::string::npos )
+                        entry.defines.emplace_back(v, "");
+                    else
+                        entry.defines.emplace_back(v.substr(0, deq), v.substr(deq+1));
+                }
+                else
+                {
+                    throw std::runtime_error(error("unknown key: " + k));
+                }
+            }
+
+            if( entry.output.empty() )
+                entry.output = isAbsolute(token) && m_outputDirectory == m_directory ? token + ".spv" : resolve(defaultOutput, m_outputDirectory);
+
+            return true;
+        }
+        return false;
+    }
+
+    std::string const & getDirectory() const
+    {
+        return m_directory;
+    }
+
+    std::string const & getOutputDirectory() const
+    {
+        return m_outputDirectory;
+    }
+
+protected:
+    static bool isAbsolute(std::string const & path)
+    {
+        return !path.empty() && (path.front() == '/' || (path.size() > 1 && path[1] == ':'));
+    }
+
+    static std::string resolve(std::string const & path, std::string const & directory)
+    {
+        if( path.empty() || isAbsolute(path) )
+            return path;
+        return directory + '/' + path;
+    }
+
+    std::string error(std::string const & msg) const
+    {
+        return "Manifest line " + std::to_string(m_line) + ": " + msg;
+    }
+
+    std::ifstream m_file;
+    std::string   m_directory;
+    std::string   m_outputDirectory;
+    size_t        m_line = 0;
+};
+
+/**
+ * @brief The ShaderManifestCompiler class
+ *
+ * Compiles all the shaders in a manifest. Each entry is read, compiled,
+ * written and released before the next one is read, so memory usage does
+ * not depend on the size of the manifest.
+ *
+ * If a journal directory is set, a small stamp file is written to it for
+ * every successfully compiled entry. It holds a hash of the source and of
+ * each file the entry included. Running the same manifest again with the
+ * same journal skips the entries whose manifest line, source and included
+ * files have not changed and whose output still exists, which allows a
+ * failed or interrupted build to be resumed. Only the stamp of the current
+ * entry is read, and each entry overwrites its own stamp, so the journal
+ * does not grow from run to run. Delete the journal to force a full rebuild.
+ *
+ * gnl::ShaderManifestCompiler<> M;
+ * M.setJournal("build/shaders.journal");
+ * M.setOutputDirectory("build/shaders");
+ * M.setProgressCallback( [](auto & progress, auto & entry, auto status, auto & error) { ... } );
+ * auto result = M.compile("shaders.manifest");
+ */
+template<typename Compiler_t = GLSLCompiler>
+class ShaderManifestCompiler
+{
+public:
+    struct Progress
+    {
+        size_t entries      = 0; // entries read from the manifest so far
+        size_t compiled     = 0;
+        size_t skipped      = 0; // compiled and unchanged according to the journal
+        size_t failed       = 0;
+        size_t bytesWritten = 0;
+        std::chrono::steady_clock::duration elapsed{0};
+
+        double shadersPerSecond() const
+        {
+            auto s = std::chrono::duration<double>(elapsed).count();
+            return s > 0.0 ? static_cast<double>(compiled) / s : 0.0;
+        }
+    };
+
+    enum class Status
+    {
+        Compiled,
+        Skipped,
+        Failed
+    };
+
+    using ProgressCallback = std::function<void(Progress const &, ShaderManifestEntry const &, Status, std::string const & error)>;
+    using IncludedFile     = GLSLFileIncluder::IncludedFile;
+
+    /**
+     * @brief setJournal
+     * @param directory
+     *
+     * The directory which holds the stamps of the compiled entries.
+     * It is created if it does not exist.
+     */
+    void setJournal(std::string const & directory)
+    {
+        m_journalPath = directory;
+    }
+
+    /**
+     * @brief setOutputDirectory
+     * @param path
+     *
+     * Relative output paths in the manifest are relative to this
+     * directory. Defaults to the directory containing the manifest.
+     */
+    void setOutputDirectory(std::string const & path)
+    {
+        m_outputDirectory = path;
+    }
+
+    /**
+     * @brief setContinueOnError
+     * @param v
+     *
+     * If true (default), failed entries are reported through the
+     * progress callback and the remaining entries are compiled.
+     * If false, the first failure throws.
+     */
+    void setContinueOnError(bool v)
+    {
+        m_continueOnError = v;
+    }
+
+    void setProgressCallback(ProgressCallback c)
+    {
+        m_callback = std::move(c);
+    }
+
+    /**
+     * @brief compile
+     * @param manifestPath
+     * @return
+     *
+     * Compile all the entries in the manifest.
+     */
+    Progress compile(std::string const & manifestPath)
+    {
+        if( !m_journalPath.empty() )
+            std::filesystem::create_directories(m_journalPath);
+
+        ShaderManifestReader reader(manifestPath, m_outputDirectory);
+        ShaderManifestEntry  entry;
+        Progress             progress;
+
+        // only used to check if included files have changed
+        Compiler_t validator;
+
+        auto t0 = std::chrono::steady_clock::now();
+
+        while( reader.next(entry) )
+        {
+            progress.entries++;
+
+            Status      status = Status::Compiled;
+            std::string error;
+
+            // the source is read once, for both the stamp and the compile
+            std::string source;
+            bool        found      = readFile(entry.input, source);
+            auto        sourceHash = hashString(source);
+
+            if( found && isUpToDate(entry, sourceHash, validator) )
+            {
+                status = Status::Skipped;
+                progress.skipped++;
+            }
+            else
+            {
+                try
+                {
+                    if( !found )
+                        throw std::runtime_error("Error opening file.");
+
+                    std::vector<IncludedFile> included;
+                    progress.bytesWritten += compileSource(entry, source, &included);
+                    progress.compiled++;
+
+                    writeStamp(entry, sourceHash, included);
+                }
+                catch (std::exception & e)
+                {
+                    status = Status::Failed;
+                    error  = e.what();
+                    progress.failed++;
+                }
+            }
+
+            progress.elapsed = std::chrono::steady_clock::now() - t0;
+
+            if( m_callback )
+                m_callback(progress, entry, status, error);
+
+            if( status == Status::Failed && !m_continueOnError )
+                throw std::runtime_error(entry.input + ": " + error);
+        }
+
+        return progress;
+    }
+
+    /**
+     * @brief compileEntry
+     * @param entry
+     * @return
+     *
+     * Compile a single entry and write it to its output path.
+     * Returns the number of bytes written.
+     */
+    static size_t compileEntry(ShaderManifestEntry const & entry)
+    {
+        std::string source;
+        if( !readFile(entry.input, source) )
+            throw std::runtime_error("Error opening file.");
+        return compileSource(entry, source, nullptr);
+    }
+
+protected:
+    // Compile the source of an entry and write it to its output path. If
+    // includedFiles is not null, it is filled with the files which were included.
+    static size_t compileSource(ShaderManifestEntry const & entry, std::string const & source, std::vector<IncludedFile> * includedFiles)
+    {
+        Compiler_t compiler;
+
+        for(auto & d : entry.defines)
+            compiler.addCompleTimeDefinition(d.first, d.second);
+
+        compiler.addIncludePath( Compiler_t::parentPath(entry.input) );
+        for(auto & i : entry.includePaths)
+            compiler.addIncludePath(i);
+
+        auto stageName = entry.stage;
+        if( stageName.empty() )
+        {
+            auto dot = entry.input.find_last_of('.');
+            stageName = dot == std::string::npos ? "" : entry.input.substr(dot);
+        }
+        auto stage = Compiler_t::shaderStageFromName(stageName);
+
+        auto spv = compiler.compile(source, stage);
+
+        if( includedFiles )
+            *includedFiles = compiler.getIncluder().getIncludedFiles();
+
+        auto parent = std::filesystem::path(entry.output).parent_path();
+        if( !parent.empty() )
+            std::filesystem::create_directories(parent);
+
+        // write to a temporary file first so that an interrupted
+        // build never leaves a partially written output behind
+        auto bytes = spv.size() * sizeof(uint32_t);
+        auto tmp   = entry.output + ".tmp";
+        {
+            std::ofstream out(tmp, std::ios_base::binary | std::ios_base::trunc);
+            if( !out )
+                throw std::runtime_error("Error opening output: " + entry.output);
+            out.write(reinterpret_cast<const char*>(spv.data()), static_cast<std::streamsize>(bytes));
+            if( !out )
+                throw std::runtime_error("Error writing output: " + entry.output);
+        }
+
+        // rename() replaces the previous output atomically
+        if( std::rename(tmp.c_str(), entry.output.c_str()) != 0 )
+            throw std::runtime_error("Error writing output: " + entry.output);
+
+        return bytes;
+    }
+
+    static bool readFile(std::string const & path, std::string & contents)
+    {
+        std::ifstream t(path, std::ios_base::binary);
+        if( !t )
+            return false;
+        contents.assign((std::istreambuf_iterator<char>(t)), std::istreambuf_iterator<char>());
+        return true;
+    }
+
+    std::string stampPath(ShaderManifestEntry const & entry) const
+    {
+        std::ostringstream name;
+        name << m_journalPath << '/' << std::hex << std::setw(16) << std::setfill('0') << entry.key() << ".stamp";
+        return name.str();
+    }
+
+    // A stamp is:
+    //
+    //   <source hash>
+    //   "<included file>" <hash>
+    //   ...
+    //
+    // The included files are checked as they are read, so only one
+    // is held in memory at a time. A stamp which cannot be parsed
+    // is treated as out of date.
+    bool isUpToDate(ShaderManifestEntry const & entry, uint64_t sourceHash, Compiler_t & validator) const
+    {
+        if( m_journalPath.empty() || !std::ifstream(entry.output) )
+            return false;
+
+        std::ifstream in(stampPath(entry));
+        uint64_t      hash = 0;
+        if( !(in >> std::hex >> hash) || hash != sourceHash )
+            return false;
+
+        IncludedFile f;
+        while( in >> std::quoted(f.path) )
+        {
+            if( !(in >> std::hex >> f.hash) || !validator.getIncluder().isUnchanged(f) )
+                return false;
+        }
+        return in.eof();
+    }
+
+    // Best effort, if the stamp cannot be written the entry is compiled again next time
+    void writeStamp(ShaderManifestEntry const & entry, uint64_t sourceHash, std::vector<IncludedFile> const & included) const
+    {
+        if( m_journalPath.empty() )
+            return;
+
+        auto path = stampPath(entry);
+        auto tmp  = path + ".tmp";
+        {
+            std::ofstream out(tmp, std::ios_base::trunc);
+            out << std::hex << sourceHash << '\n';
+            for(auto & f : included)
+                out << std::quoted(f.path) << ' ' << std::hex << f.hash << '\n';
+            if( !out )
+                return;
+        }
+        std::rename(tmp.c_str(), path.c_str());
+    }
+
+    std::string      m_journalPath;
+    std::string      m_outputDirectory;
+    bool             m_continueOnError = true;
+    ProgressCallback m_callback;
+};
+
+}
+
+#endif
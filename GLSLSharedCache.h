@@ -0,0 +1,371 @@
+#ifndef HEADER_ONLY_GLSLCOMPILER_SHARED_CACHE_H
+#define HEADER_ONLY_GLSLCOMPILER_SHARED_CACHE_H
+
+#include "GLSLCompiler.h"
+
+#if !defined(__unix__) && !defined(__APPLE__)
+#error "GLSLSharedCache.h requires a POSIX system"
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <system_error>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// When including this header in your projects: change the
+// namespace to the namespace of your project
+namespace gnl
+{
+
+/**
+ * @brief The GLSLSharedCacheDirectory class
+ *
+ * A SPIR-V cache stored in a directory which can be shared by many
+ * compiler processes on the same machine (eg: multiple build targets
+ * running in parallel).
+ *
+ *  - Entries are written to a temporary file and published with an
+ *    atomic rename(), so readers never see a partially written entry.
+ *  - On a miss, the compiler takes an advisory lock (flock) on a per-key
+ *    lock file. Other processes which miss on the same key wait for the
+ *    lock and then load the result instead of compiling it again.
+ *  - Every hit updates the modification time of the entry. If a maximum
+ *    size is given, the least recently used entries are unlinked when the
+ *    cache grows too large. Processes which already have an entry open
+ *    keep reading it, processes which try to open it afterwards simply miss.
+ *
+ * auto cache = std::make_shared<gnl::GLSLSharedCacheDirectory>("/tmp/shader-cache", 512*1024*1024);
+ * compiler.setSpirvCache(cache);
+ */
+class GLSLSharedCacheDirectory : public GLSLSpirvCache
+{
+public:
+    struct Stats
+    {
+        size_t hits    = 0;
+        size_t misses  = 0; // calls to load() which did not find a valid entry
+        size_t stores  = 0;
+        size_t trimmed = 0; // entries removed by trim()
+    };
+
+    explicit GLSLSharedCacheDirectory(std::string directory, size_t maxBytes = 0)
+        : m_directory(std::move(directory)),
+          m_maxBytes(maxBytes)
+    {
+        std::filesystem::create_directories(m_directory);
+    }
+
+    bool load(uint64_t key, std::vector<uint32_t> & spirv) override
+    {
+        int fd = ::open(entryPath(key).c_str(), O_RDONLY);
+        if( fd < 0 )
+        {
+            m_misses++;
+            return false;
+        }
+
+        bool ok = readEntry(fd, key, spirv);
+
+        // mark the entry as recently used
+        if( ok )
+            ::futimens(fd, nullptr);
+
+        ::close(fd);
+
+        ok ? m_hits++ : m_misses++;
+        return ok;
+    }
+
+    void store(uint64_t key, std::vector<uint32_t> const & spirv) override
+    {
+        auto path = entryPath(key);
+        auto tmp  = path + ".tmp." + uniqueSuffix();
+
+        int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+        if( fd < 0 )
+            return;
+
+        Header H;
+        H.magic  = Magic;
+        H.key    = key;
+        H.words  = spirv.size();
+        H.hash   = hashBytes(spirv.data(), spirv.size() * sizeof(uint32_t));
+
+        bool ok = writeAll(fd, &H, sizeof(H)) &&
+                  writeAll(fd, spirv.data(), spirv.size() * sizeof(uint32_t));
+
+        ::close(fd);
+
+        // the cache is best effort, failing to store is not an error
+        if( !ok || ::rename(tmp.c_str(), path.c_str()) != 0 )
+        {
+            ::unlink(tmp.c_str());
+            return;
+        }
+
+        m_stores++;
+
+        if( m_maxBytes > 0 )
+        {
+            auto written = m_bytesSinceTrim += sizeof(H) + spirv.size() * sizeof(uint32_t);
+            if( written > m_maxBytes / 8 )
+            {
+                m_bytesSinceTrim = 0;
+                trim(m_maxBytes);
+            }
+        }
+    }
+
+    std::shared_ptr<void> lock(uint64_t key) override
+    {
+        int fd = ::open(lockPath(key).c_str(), O_RDWR | O_CREAT, 0644);
+        if( fd < 0 )
+            return nullptr;
+
+        while( ::flock(fd, LOCK_EX) != 0 )
+        {
+            if( errno != EINTR )
+            {
+                ::close(fd);
+                return nullptr;
+            }
+        }
+
+        // the handle must not be null, the compiler treats a null
+        // handle as failing to take the lock
+        return std::shared_ptr<void>(new int(fd), [](void * p)
+        {
+            auto * handle = static_cast<int*>(p);
+            ::flock(*handle, LOCK_UN);
+            ::close(*handle);
+            delete handle;
+        });
+    }
+
+    /**
+     * @brief trim
+     * @param maxBytes
+     *
+     * Removes the least recently used entries until the total size of the
+     * cache is at most maxBytes. Also removes temporary files and lock files
+     * which have been left behind by processes which were killed.
+     */
+    void trim(size_t maxBytes)
+    {
+        struct Item
+        {
+            std::string path;
+            size_t      size;
+            timespec    mtime;
+        };
+
+        std::vector<Item> entries;
+        size_t            total = 0;
+
+        auto now = ::time(nullptr);
+
+        std::error_code ec;
+        for(auto & d : std::filesystem::directory_iterator(m_directory, ec))
+        {
+            auto path = d.path().string();
+
+            struct stat st;
+            if( ::stat(path.c_str(), &st) != 0 )
+                continue; // removed by someone else
+
+            bool stale = now - st.st_mtime > StaleSeconds;
+
+            if( path.find(".spv.tmp.") != std::string::npos )
+            {
+                if( stale )
+                    ::unlink(path.c_str());
+            }
+            else if( endsWith(path, ".lock") )
+            {
+                if( stale )
+                    removeLockFile(path);
+            }
+            else if( endsWith(path, ".spv") )
+            {
+#if defined(__APPLE__)
+                entries.push_back( {path, static_cast<size_t>(st.st_size), st.st_mtimespec} );
+#else
+                entries.push_back( {path, static_cast<size_t>(st.st_size), st.st_mtim} );
+#endif
+                total += static_cast<size_t>(st.st_size);
+            }
+        }
+
+        if( total <= maxBytes )
+            return;
+
+        std::sort(entries.begin(), entries.end(), [](Item const & a, Item const & b)
+        {
+            return a.mtime.tv_sec != b.mtime.tv_sec ? a.mtime.tv_sec < b.mtime.tv_sec : a.mtime.tv_nsec < b.mtime.tv_nsec;
+        });
+
+        for(auto & e : entries)
+        {
+            if( total <= maxBytes )
+                break;
+
+            // unlinking is safe while other processes are reading the
+            // entry, they keep their open file
+            if( ::unlink(e.path.c_str()) == 0 )
+                m_trimmed++;
+            total -= e.size;
+        }
+    }
+
+    Stats getStats() const
+    {
+        Stats S;
+        S.hits    = m_hits;
+        S.misses  = m_misses;
+        S.stores  = m_stores;
+        S.trimmed = m_trimmed;
+        return S;
+    }
+
+    std::string const & getDirectory() const
+    {
+        return m_directory;
+    }
+
+protected:
+    static constexpr uint64_t Magic        = 0x3176707363736c67ull; // "glscspv1"
+    static constexpr long     StaleSeconds = 60*60;
+
+    struct Header
+    {
+        uint64_t magic;
+        uint64_t key;
+        uint64_t words;
+        uint64_t hash;
+    };
+
+    std::string entryPath(uint64_t key) const
+    {
+        return m_directory + '/' + toHex(key) + ".spv";
+    }
+
+    std::string lockPath(uint64_t key) const
+    {
+        return m_directory + '/' + toHex(key) + ".lock";
+    }
+
+    static std::string toHex(uint64_t key)
+    {
+        char buf[17];
+        std::snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(key));
+        return buf;
+    }
+
+    static bool endsWith(std::string const & s, std::string const & suffix)
+    {
+        return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+
+    static std::string uniqueSuffix()
+    {
+        static std::atomic<uint64_t> counter(0);
+        auto tid = std::hash<std::thread::id>()(std::this_thread::get_id());
+        return std::to_string(::getpid()) + '.' + toHex(tid) + '.' + std::to_string(counter++);
+    }
+
+    // Only remove a lock file if nobody is holding it. Another process
+    // may still open the old path just before it is unlinked, the worst
+    // case is that the same shader is compiled twice.
+    static void removeLockFile(std::string const & path)
+    {
+        int fd = ::open(path.c_str(), O_RDWR);
+        if( fd < 0 )
+            return;
+        if( ::flock(fd, LOCK_EX | LOCK_NB) == 0 )
+        {
+            ::unlink(path.c_str());
+            ::flock(fd, LOCK_UN);
+        }
+        ::close(fd);
+    }
+
+    static bool readAll(int fd, void * data, size_t size)
+    {
+        auto * p = static_cast<char*>(data);
+        while( size > 0 )
+        {
+            auto r = ::read(fd, p, size);
+            if( r < 0 && errno == EINTR )
+                continue;
+            if( r <= 0 )
+                return false;
+            p    += r;
+            size -= static_cast<size_t>(r);
+        }
+        return true;
+    }
+
+    static bool writeAll(int fd, void const * data, size_t size)
+    {
+        auto const * p = static_cast<char const*>(data);
+        while( size > 0 )
+        {
+            auto r = ::write(fd, p, size);
+            if( r < 0 && errno == EINTR )
+                continue;
+            if( r <= 0 )
+                return false;
+            p    += r;
+            size -= static_cast<size_t>(r);
+        }
+        return true;
+    }
+
+    static bool readEntry(int fd, uint64_t key, std::vector<uint32_t> & spirv)
+    {
+        struct stat st;
+        if( ::fstat(fd, &st) != 0 )
+            return false;
+
+        Header H;
+        if( static_cast<size_t>(st.st_size) < sizeof(H) || !readAll(fd, &H, sizeof(H)) )
+            return false;
+
+        if( H.magic != Magic || H.key != key ||
+            static_cast<size_t>(st.st_size) != sizeof(H) + H.words * sizeof(uint32_t) )
+            return false;
+
+        std::vector<uint32_t> words(H.words);
+        if( !readAll(fd, words.data(), words.size() * sizeof(uint32_t)) )
+            return false;
+
+        if( hashBytes(words.data(), words.size() * sizeof(uint32_t)) != H.hash )
+            return false;
+
+        spirv = std::move(words);
+        return true;
+    }
+
+    std::string         m_directory;
+    size_t              m_maxBytes;
+    std::atomic<size_t> m_bytesSinceTrim{0};
+
+    std::atomic<size_t> m_hits{0};
+    std::atomic<size_t> m_misses{0};
+    std::atomic<size_t> m_stores{0};
+    std::atomic<size_t> m_trimmed{0};
+};
+
+}
+
+#endif
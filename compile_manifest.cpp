@@ -0,0 +1,90 @@
+#include <iostream>
+#include "GLSLShaderManifest.h"
+
+//
+// Compiles all the shaders listed in a manifest file.
+//
+// Usage:
+//
+//    compile_manifest <manifest> [--output-dir DIR] [--journal DIR] [--stop-on-error]
+//
+// Relative outputs are written to the output directory, which defaults
+// to the directory containing the manifest. If a journal is given,
+// shaders which were compiled successfully by a previous run, and
+// have not changed since, are skipped.
+//
+int main(int argc, char ** argv)
+{
+    if( argc < 2 )
+    {
+        std::cout << "Usage: " << argv[0] << " <manifest> [--output-dir DIR] [--journal DIR] [--stop-on-error]" << std::endl;
+        return 1;
+    }
+
+    gnl::ShaderManifestCompiler<> manifestCompiler;
+
+    for(int i=2; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if( arg == "--output-dir" && i+1 < argc)
+            manifestCompiler.setOutputDirectory(argv[++i]);
+        else if( arg == "--journal" && i+1 < argc)
+            manifestCompiler.setJournal(argv[++i]);
+        else if( arg == "--stop-on-error")
+            manifestCompiler.setContinueOnError(false);
+    }
+
+    using Compiler = gnl::ShaderManifestCompiler<>;
+
+    auto lastReport = std::chrono::steady_clock::now();
+
+    manifestCompiler.setProgressCallback(
+        [&](Compiler::Progress const & p, gnl::ShaderManifestEntry const & entry, Compiler::Status status, std::string const & error)
+        {
+            if( status == Compiler::Status::Failed )
+            {
+                std::cout << entry.input << " (line " << entry.line << ") failed:\n" << error << std::endl;
+            }
+
+            // report at most once per second
+            auto now = std::chrono::steady_clock::now();
+            if( now - lastReport > std::chrono::seconds(1) )
+            {
+                lastReport = now;
+                std::cout << p.entries << " entries: "
+                          << p.compiled << " compiled, "
+                          << p.skipped  << " skipped, "
+                          << p.failed   << " failed ("
+                          << p.shadersPerSecond() << " shaders/sec)" << std::endl;
+            }
+        });
+
+    // must call this first to initialise the glslang compiler backend
+    // it must be called once per process
+    glslang::InitializeProcess();
+
+    int ret = 0;
+    try
+    {
+        auto p = manifestCompiler.compile(argv[1]);
+
+        std::cout << "Done. "
+                  << p.compiled << " compiled, "
+                  << p.skipped  << " skipped, "
+                  << p.failed   << " failed, "
+                  << p.bytesWritten << " bytes written in "
+                  << std::chrono::duration<double>(p.elapsed).count() << "s" << std::endl;
+
+        ret = p.failed > 0 ? 1 : 0;
+    }
+    catch (std::exception & e)
+    {
+        std::cout << e.what() << std::endl;
+        ret = 1;
+    }
+
+    // this must be called to clean up the process
+    // it should be called once per process.
+    glslang::FinalizeProcess();
+    return ret;
+}
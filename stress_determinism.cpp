@@ -0,0 +1,367 @@
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <sstream>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include "GLSLCompiler.h"
+
+//
+// Generates a set of randomized (but valid) shaders, compiles them on a
+// single thread to get reference SPIR-V, and then compiles them again
+// concurrently on 1..N threads. Every result must be bit-identical to the
+// reference, otherwise the process exits with a non-zero value.
+//
+// With --shared-cache, the shaders also #include a generated file and use
+// definitions from a small set of interned preambles, each shader is listed
+// twice, and all the threads share one GLSLPreprocessedCache. The reference
+// is still compiled without a cache.
+//
+// Usage:
+//
+//    stress_determinism [--shaders COUNT] [--threads MAX_THREADS] [--seed SEED] [--shared-cache]
+//
+
+struct GeneratedShader
+{
+    std::string source;
+    EShLanguage stage;
+    std::shared_ptr<const gnl::GLSLPreamble> preamble; // only used with --shared-cache
+};
+
+class ShaderGenerator
+{
+public:
+    explicit ShaderGenerator(uint32_t seed) : m_rand(seed)
+    {
+    }
+
+    // The include file used with --shared-cache. Its functions
+    // use the SCALE and STEPS definitions from the preamble.
+    std::string generateInclude()
+    {
+        std::ostringstream out;
+        out << "float common0(float x)\n{\n    return x * SCALE + " << floatLiteral() << ";\n}\n";
+        out << "float common1(float x, vec3 v)\n{\n";
+        out << "    float r = " << floatLiteral() << ";\n";
+        out << "    for(int j=0; j < STEPS; j++)\n";
+        out << "        r += " << floatExpression(2, 0) << ";\n";
+        out << "    return r;\n}\n";
+        return out.str();
+    }
+
+    // A random preamble from a small set, so that the same
+    // definitions are shared by many shaders.
+    std::shared_ptr<const gnl::GLSLPreamble> generatePreamble(gnl::GLSLPreamblePool & pool)
+    {
+        auto variant = random(0,3);
+        return pool.intern({ {"SCALE", std::to_string(variant + 1) + ".5"},
+                             {"STEPS", std::to_string(variant + 2)} });
+    }
+
+    GeneratedShader generate(bool useInclude = false)
+    {
+        GeneratedShader S;
+        S.stage = random(0,1) == 0 ? EShLangFragment : EShLangCompute;
+
+        std::ostringstream out;
+
+        out << "#version 450\n";
+
+        if( useInclude )
+        {
+            out << "#extension GL_GOOGLE_include_directive : enable\n";
+            out << "#include \"common.glsl\"\n";
+        }
+
+        if( S.stage == EShLangFragment)
+        {
+            out << "layout(location = 0) in vec3 f_Position;\n";
+            out << "layout(location = 0) out vec4 outColor;\n";
+        }
+        else
+        {
+            out << "layout(local_size_x = " << (1 << random(0,6)) << ") in;\n";
+            out << "layout(std430, binding = 0) buffer Data { float values[]; };\n";
+        }
+
+        int functionCount = random(1,6);
+        for(int i=0; i < functionCount; i++)
+        {
+            out << "float func" << i << "(float x, vec3 v)\n{\n";
+            out << "    float r = " << floatExpression(3, i) << ";\n";
+            if( random(0,1) )
+            {
+                out << "    for(int j=0; j < " << random(1,8) << "; j++)\n";
+                out << "        r += " << floatExpression(2, i) << ";\n";
+            }
+            out << "    return r;\n}\n";
+        }
+
+        out << "void main()\n{\n";
+        if( S.stage == EShLangFragment)
+            out << "    vec3 v = f_Position;\n";
+        else
+            out << "    vec3 v = vec3(gl_GlobalInvocationID);\n";
+
+        out << "    float x = " << floatLiteral() << ";\n";
+        out << "    float r = " << floatExpression(2, functionCount) << ";\n";
+
+        if( useInclude )
+            out << "    r += common0(x) + common1(r, v);\n";
+
+        if( S.stage == EShLangFragment)
+            out << "    outColor = vec4(v * r, 1.0);\n";
+        else
+            out << "    values[gl_GlobalInvocationID.x] = r;\n";
+        out << "}\n";
+
+        S.source = out.str();
+        return S;
+    }
+
+protected:
+    int random(int a, int b)
+    {
+        return std::uniform_int_distribution<int>(a,b)(m_rand);
+    }
+
+    std::string floatLiteral()
+    {
+        std::ostringstream out;
+        out << random(0,99) << '.' << random(0,99);
+        return out.str();
+    }
+
+    // builds a random float expression. Only functions with an index
+    // less than functionCount can be called
+    std::string floatExpression(int depth, int functionCount)
+    {
+        if( depth == 0 )
+        {
+            switch( random(0,4) )
+            {
+                case 0:  return "x";
+                case 1:  return "v.x";
+                case 2:  return "v.y";
+                case 3:  return "v.z";
+                default: return floatLiteral();
+            }
+        }
+
+        auto a = floatExpression(depth-1, functionCount);
+        auto b = floatExpression(depth-1, functionCount);
+
+        switch( random(0, functionCount > 0 ? 8 : 7) )
+        {
+            case 0:  return "(" + a + " + " + b + ")";
+            case 1:  return "(" + a + " - " + b + ")";
+            case 2:  return "(" + a + " * " + b + ")";
+            case 3:  return "sin(" + a + ")";
+            case 4:  return "abs(" + a + ")";
+            case 5:  return "max(" + a + ", " + b + ")";
+            case 6:  return "mix(" + a + ", " + b + ", 0.5)";
+            case 7:  return "dot(v, vec3(" + a + "))";
+            default: return "func" + std::to_string(random(0, functionCount-1)) + "(" + a + ", v)";
+        }
+    }
+
+    std::mt19937 m_rand;
+};
+
+// Compile all the shaders using numThreads threads. Each thread uses its own compiler.
+// If cache is not null, it is shared by all the compilers.
+// Returns the number of shaders which failed to compile.
+size_t compileAll(std::vector<GeneratedShader> const & shaders,
+                  std::vector< std::vector<uint32_t> > & output,
+                  unsigned int numThreads,
+                  std::string const & includePath,
+                  std::shared_ptr<gnl::GLSLPreprocessedCache> const & cache)
+{
+    output.assign(shaders.size(), {});
+
+    std::atomic<size_t> next(0);
+    std::atomic<size_t> failures(0);
+
+    auto worker = [&]()
+    {
+        gnl::GLSLCompiler compiler;
+        if( !includePath.empty() )
+            compiler.addIncludePath(includePath);
+        compiler.setPreprocessedCache(cache);
+
+        for(size_t i = next++; i < shaders.size(); i = next++)
+        {
+            try
+            {
+                if( shaders[i].preamble )
+                    compiler.setPreamble(shaders[i].preamble);
+                output[i] = compiler.compile(shaders[i].source, shaders[i].stage);
+            }
+            catch (...)
+            {
+                if( failures++ == 0 )
+                {
+                    std::cout << "Shader " << i << " failed to compile:\n" << compiler.getLog() << std::endl;
+                    std::cout << shaders[i].source << std::endl;
+                }
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for(unsigned int t=0; t < numThreads; t++)
+        threads.emplace_back(worker);
+    for(auto & t : threads)
+        t.join();
+
+    return failures;
+}
+
+int main(int argc, char ** argv)
+{
+    size_t       shaderCount = 2000;
+    unsigned int maxThreads  = std::max(1u, std::thread::hardware_concurrency());
+    uint32_t     seed        = 1;
+    bool         sharedCache = false;
+
+    for(int i=1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if( arg == "--shaders" && i+1 < argc)
+            shaderCount = std::stoul(argv[++i]);
+        else if( arg == "--threads" && i+1 < argc)
+            maxThreads = std::max(1u, static_cast<unsigned int>(std::stoul(argv[++i])));
+        else if( arg == "--seed" && i+1 < argc)
+            seed = static_cast<uint32_t>(std::stoul(argv[++i]));
+        else if( arg == "--shared-cache")
+            sharedCache = true;
+    }
+
+    // must call this first to initialise the glslang compiler backend
+    // it must be called once per process
+    glslang::InitializeProcess();
+
+    ShaderGenerator       generator(seed);
+    gnl::GLSLPreamblePool preambles;
+    std::string           includePath;
+
+    if( sharedCache )
+    {
+        auto dir = std::filesystem::temp_directory_path() / ("stress_determinism_" + std::to_string(seed));
+        std::filesystem::create_directories(dir);
+        std::ofstream( (dir / "common.glsl").string() ) << generator.generateInclude();
+        includePath = dir.string();
+    }
+
+    std::vector<GeneratedShader> shaders;
+    for(size_t i=0; i < shaderCount; i++)
+    {
+        auto S = generator.generate(sharedCache);
+        if( sharedCache )
+        {
+            // listed twice so that concurrent compiles of the same shader hit the cache
+            S.preamble = generator.generatePreamble(preambles);
+            shaders.push_back(S);
+        }
+        shaders.push_back( std::move(S) );
+    }
+
+    // the reference output, compiled on the main thread without a cache.
+    std::vector< std::vector<uint32_t> > reference;
+    {
+        gnl::GLSLCompiler compiler;
+        if( !includePath.empty() )
+            compiler.addIncludePath(includePath);
+
+        reference.resize(shaders.size());
+        for(size_t i=0; i < shaders.size(); i++)
+        {
+            try
+            {
+                if( shaders[i].preamble )
+                    compiler.setPreamble(shaders[i].preamble);
+                reference[i] = compiler.compile(shaders[i].source, shaders[i].stage);
+            }
+            catch (...)
+            {
+                std::cout << "Shader " << i << " failed to compile:\n" << compiler.getLog() << std::endl;
+                std::cout << shaders[i].source << std::endl;
+                glslang::FinalizeProcess();
+                return 1;
+            }
+        }
+    }
+
+    std::vector<unsigned int> threadCounts;
+    for(unsigned int t=1; t < maxThreads; t *= 2)
+        threadCounts.push_back(t);
+    threadCounts.push_back(maxThreads);
+
+    std::cout << "Compiling " << shaders.size() << " shaders (seed " << seed << ")"
+              << (sharedCache ? " with a shared preprocessed cache" : "") << std::endl;
+    std::cout << std::setw(8)  << "threads"
+              << std::setw(12) << "seconds"
+              << std::setw(14) << "shaders/sec"
+              << std::setw(10) << "speedup"
+              << std::setw(12) << "efficiency"
+              << std::setw(12) << "mismatches"
+              << std::setw(12) << "cache hits" << std::endl;
+
+    int    ret = 0;
+    double baseRate = 0.0;
+
+    for(auto numThreads : threadCounts)
+    {
+        std::vector< std::vector<uint32_t> > output;
+
+        // a new cache for every run, so each run starts cold
+        std::shared_ptr<gnl::GLSLPreprocessedCache> cache;
+        if( sharedCache )
+            cache = std::make_shared<gnl::GLSLPreprocessedCache>();
+
+        auto t0       = std::chrono::steady_clock::now();
+        auto failures = compileAll(shaders, output, numThreads, includePath, cache);
+        auto seconds  = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+        size_t mismatches = 0;
+        for(size_t i=0; i < shaders.size(); i++)
+        {
+            if( output[i] != reference[i] )
+            {
+                if( mismatches++ == 0 )
+                    std::cout << "Shader " << i << " produced different SPIR-V on " << numThreads << " threads" << std::endl;
+            }
+        }
+
+        double rate = static_cast<double>(shaders.size()) / seconds;
+        if( baseRate == 0.0 )
+            baseRate = rate;
+
+        std::cout << std::setw(8)  << numThreads
+                  << std::setw(12) << std::fixed << std::setprecision(3) << seconds
+                  << std::setw(14) << std::setprecision(1) << rate
+                  << std::setw(10) << std::setprecision(2) << rate / baseRate
+                  << std::setw(12) << std::setprecision(2) << rate / baseRate / numThreads
+                  << std::setw(12) << mismatches
+                  << std::setw(12) << (cache ? cache->getStats().hits : 0) << std::endl;
+
+        if( failures > 0 || mismatches > 0 )
+            ret = 1;
+    }
+
+    if( !includePath.empty() )
+        std::filesystem::remove_all(includePath);
+
+    // this must be called to clean up the process
+    // it should be called once per process.
+    glslang::FinalizeProcess();
+
+    return ret;
+}
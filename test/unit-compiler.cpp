@@ -42,3 +42,146 @@ SCENARIO("Compile a Compute Shader")
     glslang::FinalizeProcess();
 }
 
+
+SCENARIO("Resolve system includes from the system include paths")
+{
+    glslang::InitializeProcess();
+
+    std::ifstream t(CMAKE_SOURCE_DIR "/data/fragmentShaderInclude.frag");
+    std::string src((std::istreambuf_iterator<char>(t)), std::istreambuf_iterator<char>());
+
+    auto reference = gnl::GLSLCompiler::compileFromFile(CMAKE_SOURCE_DIR "/data/fragmentShaderInclude.frag", {CMAKE_SOURCE_DIR "/data/include"});
+
+    src.replace( src.find("\"getcolor.glsl\""), 15, "<getcolor.glsl>");
+
+    gnl::GLSLCompiler compiler;
+
+    REQUIRE_THROWS( compiler.compile(src, EShLangFragment) );
+
+    compiler.addSystemIncludePath(CMAKE_SOURCE_DIR "/data/include");
+
+    REQUIRE( compiler.compile(src, EShLangFragment) == reference );
+    REQUIRE( compiler.getIncluder().getIncludedFiles().size() == 1 );
+
+    glslang::FinalizeProcess();
+}
+
+
+SCENARIO("Reuse preprocessed sources from a GLSLPreprocessedCache")
+{
+    glslang::InitializeProcess();
+
+    std::ifstream t(CMAKE_SOURCE_DIR "/data/fragmentShaderInclude.frag");
+    std::string src((std::istreambuf_iterator<char>(t)), std::istreambuf_iterator<char>());
+
+    auto cache = std::make_shared<gnl::GLSLPreprocessedCache>();
+
+    GIVEN("A compiler using the cache")
+    {
+        gnl::GLSLCompiler compiler;
+        compiler.addIncludePath(CMAKE_SOURCE_DIR "/data/include");
+        compiler.setPreprocessedCache(cache);
+
+        auto first = compiler.compile(src, EShLangFragment);
+
+        REQUIRE( cache->size() == 1);
+        REQUIRE( cache->getStats().misses == 1);
+        REQUIRE( cache->getStats().hits   == 0);
+
+        THEN("Compiling the same source again hits the cache and produces the same SPIR-V")
+        {
+            compiler.getIncluder().clearIncludedFiles();
+            auto second = compiler.compile(src, EShLangFragment);
+
+            REQUIRE( cache->getStats().hits == 1);
+            REQUIRE( first == second );
+            REQUIRE( compiler.getIncluder().getIncludedFiles().size() == 1);
+        }
+
+        THEN("A compiler targeting a different SPIR-V version can share the cache")
+        {
+            gnl::GLSLCompiler1115 compiler2;
+            compiler2.addIncludePath(CMAKE_SOURCE_DIR "/data/include");
+            compiler2.setPreprocessedCache(cache);
+
+            auto spv = compiler2.compile(src, EShLangFragment);
+
+            REQUIRE( spv.size() > 0);
+            REQUIRE( cache->getStats().hits == 1);
+            REQUIRE( compiler2.getIncluder().getIncludedFiles().size() == 1);
+        }
+
+        THEN("Adding a compile time definition misses the cache")
+        {
+            compiler.addCompleTimeDefinition("UNUSED_VALUE", "1");
+            compiler.compile(src, EShLangFragment);
+
+            REQUIRE( cache->getStats().hits   == 0);
+            REQUIRE( cache->getStats().misses == 2);
+            REQUIRE( cache->size() == 2);
+        }
+    }
+
+    glslang::FinalizeProcess();
+}
+
+SCENARIO("Share preambles between compilers")
+{
+    glslang::InitializeProcess();
+
+    gnl::GLSLPreamblePool pool;
+
+    auto a = pool.intern({ {"DEFAULT_COLOR", "vec3(1,1,1)"}, {"UNUSED_FLAG", ""} });
+    auto b = pool.intern({ {"DEFAULT_COLOR", "vec3(1,1,1)"}, {"UNUSED_FLAG", ""} });
+    auto c = pool.intern({ {"DEFAULT_COLOR", "vec3(1,0,0)"} });
+
+    REQUIRE( a == b );
+    REQUIRE( a != c );
+    REQUIRE( pool.size() == 2);
+    REQUIRE( a->str() == "#define DEFAULT_COLOR vec3(1,1,1)\n#define UNUSED_FLAG \n" );
+    REQUIRE( a->hash() == gnl::hashString(a->str()) );
+    REQUIRE( pool.intern(a->str()) == a );
+
+    for(auto const & d : std::vector< std::vector<gnl::GLSLPreamble::Definition> >{ {}, { {"A", ""} }, { {"A", "1"}, {"B", "2"} } })
+    {
+        auto p = gnl::GLSLPreamble::create(d);
+        REQUIRE( gnl::GLSLPreamble::hashDefinitions(d) == p->hash() );
+        REQUIRE( p->equals(d) );
+        REQUIRE( !p->equals({ {"C", ""} }) );
+    }
+
+    std::string src = R"(
+    #version 450
+    layout(location = 0) out vec4 outColor;
+    void main()
+    {
+        outColor = vec4( DEFAULT_COLOR, 1);
+    }
+    )";
+
+    THEN("A shared preamble gives the same result as adding the definitions")
+    {
+        gnl::GLSLCompiler compiler1;
+        compiler1.addCompleTimeDefinition("DEFAULT_COLOR", "vec3(1,1,1)");
+        compiler1.addCompleTimeDefinition("UNUSED_FLAG");
+
+        gnl::GLSLCompiler compiler2;
+        compiler2.setPreamble(a);
+
+        REQUIRE( compiler1.getPreamble()->str() == a->str() );
+        REQUIRE( compiler1.getPreamble()->hash() == a->hash() );
+        REQUIRE( compiler1.compile(src, EShLangFragment) == compiler2.compile(src, EShLangFragment) );
+    }
+
+    THEN("Adding a definition after setting a preamble does not modify the shared preamble")
+    {
+        gnl::GLSLCompiler compiler;
+        compiler.setPreamble(c);
+        compiler.addCompleTimeDefinition("UNUSED_VALUE", "1");
+
+        REQUIRE( compiler.getPreamble()->str() == "#define DEFAULT_COLOR vec3(1,0,0)\n#define UNUSED_VALUE 1\n" );
+        REQUIRE( c->str() == "#define DEFAULT_COLOR vec3(1,0,0)\n" );
+    }
+
+    glslang::FinalizeProcess();
+}
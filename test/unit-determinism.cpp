@@ -0,0 +1,141 @@
+#include <catch2/catch.hpp>
+#include <GLSLCompiler.h>
+#include <thread>
+
+SCENARIO("Compiled SPIR-V is identical across runs and threads")
+{
+    glslang::InitializeProcess();
+
+    std::vector< std::pair<std::string, EShLanguage> > shaders;
+    for(auto const & f : { std::make_pair(std::string(CMAKE_SOURCE_DIR "/data/vertexShader.vert")  , EShLangVertex),
+                           std::make_pair(std::string(CMAKE_SOURCE_DIR "/data/fragmentShader.frag"), EShLangFragment),
+                           std::make_pair(std::string(CMAKE_SOURCE_DIR "/data/genBRDF.comp")       , EShLangCompute) })
+    {
+        std::ifstream t(f.first);
+        std::string src((std::istreambuf_iterator<char>(t)), std::istreambuf_iterator<char>());
+        shaders.emplace_back(src, f.second);
+    }
+
+    std::vector< std::vector<uint32_t> > reference;
+    {
+        gnl::GLSLCompiler compiler;
+        for(auto & s : shaders)
+            reference.push_back( compiler.compile(s.first, s.second) );
+    }
+
+    THEN("Compiling again on the same thread produces identical SPIR-V")
+    {
+        gnl::GLSLCompiler compiler;
+        for(size_t i=0; i < shaders.size(); i++)
+        {
+            REQUIRE( compiler.compile(shaders[i].first, shaders[i].second) == reference[i] );
+        }
+    }
+
+    THEN("Compiling concurrently produces identical SPIR-V")
+    {
+        const size_t numThreads = 8;
+        const size_t iterations = 10;
+
+        std::vector<size_t> mismatches(numThreads, 0);
+        std::vector<std::thread> threads;
+
+        for(size_t t=0; t < numThreads; t++)
+        {
+            threads.emplace_back([&, t]()
+            {
+                gnl::GLSLCompiler compiler;
+                for(size_t j=0; j < iterations; j++)
+                {
+                    for(size_t i=0; i < shaders.size(); i++)
+                    {
+                        // an exception escaping a thread would terminate the test
+                        try
+                        {
+                            if( compiler.compile(shaders[i].first, shaders[i].second) != reference[i] )
+                                mismatches[t]++;
+                        }
+                        catch (...)
+                        {
+                            mismatches[t]++;
+                        }
+                    }
+                }
+            });
+        }
+        for(auto & t : threads)
+            t.join();
+
+        for(auto m : mismatches)
+            REQUIRE( m == 0 );
+    }
+
+    glslang::FinalizeProcess();
+}
+
+SCENARIO("Compiled SPIR-V is identical when threads share a preprocessed cache")
+{
+    glslang::InitializeProcess();
+
+    std::ifstream t(CMAKE_SOURCE_DIR "/data/fragmentShaderInclude.frag");
+    std::string src((std::istreambuf_iterator<char>(t)), std::istreambuf_iterator<char>());
+
+    gnl::GLSLPreamblePool pool;
+    std::vector< std::shared_ptr<const gnl::GLSLPreamble> > preambles = { pool.intern({ {"UNUSED_VALUE", "1"} }),
+                                                                          pool.intern({ {"UNUSED_VALUE", "2"}, {"UNUSED_FLAG", ""} }) };
+
+    // compiled without a cache
+    std::vector< std::vector<uint32_t> > reference;
+    {
+        gnl::GLSLCompiler compiler;
+        compiler.addIncludePath(CMAKE_SOURCE_DIR "/data/include");
+        for(auto & p : preambles)
+        {
+            compiler.setPreamble(p);
+            reference.push_back( compiler.compile(src, EShLangFragment) );
+        }
+    }
+
+    auto cache = std::make_shared<gnl::GLSLPreprocessedCache>();
+
+    const size_t numThreads = 8;
+    const size_t iterations = 10;
+
+    std::vector<size_t> mismatches(numThreads, 0);
+    std::vector<std::thread> threads;
+
+    for(size_t t=0; t < numThreads; t++)
+    {
+        threads.emplace_back([&, t]()
+        {
+            gnl::GLSLCompiler compiler;
+            compiler.addIncludePath(CMAKE_SOURCE_DIR "/data/include");
+            compiler.setPreprocessedCache(cache);
+            for(size_t j=0; j < iterations; j++)
+            {
+                for(size_t i=0; i < preambles.size(); i++)
+                {
+                    try
+                    {
+                        compiler.setPreamble(preambles[i]);
+                        if( compiler.compile(src, EShLangFragment) != reference[i] )
+                            mismatches[t]++;
+                    }
+                    catch (...)
+                    {
+                        mismatches[t]++;
+                    }
+                }
+            }
+        });
+    }
+    for(auto & t : threads)
+        t.join();
+
+    for(auto m : mismatches)
+        REQUIRE( m == 0 );
+    REQUIRE( cache->size() == preambles.size() );
+    REQUIRE( cache->getStats().hits > 0 );
+
+    glslang::FinalizeProcess();
+}
@@ -0,0 +1,128 @@
+#include <catch2/catch.hpp>
+#include <GLSLIncluder.h>
+
+using MemoryCompiler = gnl::GLSLCompiler_t<glslang::EShTargetVulkan_1_0, glslang::EShTargetSpv_1_0, gnl::GLSLMemoryIncluder>;
+#if defined(GNL_GLSL_HAS_MMAP)
+using PackCompiler   = gnl::GLSLCompiler_t<glslang::EShTargetVulkan_1_0, glslang::EShTargetSpv_1_0, gnl::GLSLPackIncluder>;
+#endif
+
+static std::string readSource(std::string const & path)
+{
+    std::ifstream t(path);
+    return std::string((std::istreambuf_iterator<char>(t)), std::istreambuf_iterator<char>());
+}
+
+SCENARIO("Normalize include paths")
+{
+    REQUIRE( gnl::normalizeIncludePath("./include/getcolor.glsl")            == "include/getcolor.glsl");
+    REQUIRE( gnl::normalizeIncludePath("include//../include/getcolor.glsl")  == "include/getcolor.glsl");
+    REQUIRE( gnl::normalizeIncludePath("include\\getcolor.glsl")             == "include/getcolor.glsl");
+    REQUIRE( gnl::normalizeIncludePath("/data/./include/getcolor.glsl")      == "/data/include/getcolor.glsl");
+    REQUIRE( gnl::normalizeIncludePath("../getcolor.glsl")                   == "../getcolor.glsl");
+
+    THEN("The output buffer can be reused")
+    {
+        std::string buffer;
+        gnl::normalizeIncludePath("/data/./include/../include/getcolor.glsl", buffer);
+        REQUIRE( buffer == "/data/include/getcolor.glsl");
+
+        gnl::normalizeIncludePath("include/a/../b.glsl", buffer);
+        REQUIRE( buffer == "include/b.glsl");
+    }
+}
+
+SCENARIO("Resolve includes from memory")
+{
+    glslang::InitializeProcess();
+
+    auto src       = readSource(CMAKE_SOURCE_DIR "/data/fragmentShaderInclude.frag");
+    auto reference = gnl::GLSLCompiler::compileFromFile(CMAKE_SOURCE_DIR "/data/fragmentShaderInclude.frag", {CMAKE_SOURCE_DIR "/data/include"});
+
+    MemoryCompiler compiler;
+    compiler.getIncluder().getBackend().addFile("include/getcolor.glsl", readSource(CMAKE_SOURCE_DIR "/data/include/getcolor.glsl"));
+
+    THEN("Local includes are found using the include paths")
+    {
+        compiler.addIncludePath("include");
+        REQUIRE( compiler.compile(src, EShLangFragment) == reference );
+    }
+
+    THEN("Directories on disk can be added")
+    {
+        MemoryCompiler compiler2;
+        compiler2.getIncluder().getBackend().addDirectory(CMAKE_SOURCE_DIR "/data/include", "shaders/include");
+        compiler2.addIncludePath("shaders/include");
+        REQUIRE( compiler2.compile(src, EShLangFragment) == reference );
+    }
+
+    THEN("System includes are found using the system include paths")
+    {
+        std::string systemSrc = src;
+        systemSrc.replace( systemSrc.find("\"getcolor.glsl\""), 15, "<getcolor.glsl>");
+
+        REQUIRE_THROWS( compiler.compile(systemSrc, EShLangFragment) );
+
+        // only the system include paths are searched, not the root
+        compiler.getIncluder().getBackend().addFile("getcolor.glsl", readSource(CMAKE_SOURCE_DIR "/data/include/getcolor.glsl"));
+        REQUIRE_THROWS( compiler.compile(systemSrc, EShLangFragment) );
+
+        compiler.addSystemIncludePath("include");
+        REQUIRE( compiler.compile(systemSrc, EShLangFragment) == reference );
+    }
+
+    THEN("Cached preprocessed sources are invalidated when a file changes")
+    {
+        auto cache = std::make_shared<gnl::GLSLPreprocessedCache>();
+        compiler.setPreprocessedCache(cache);
+        compiler.addIncludePath("include");
+
+        compiler.compile(src, EShLangFragment);
+        compiler.compile(src, EShLangFragment);
+        REQUIRE( cache->getStats().hits == 1);
+
+        compiler.getIncluder().getBackend().addFile("include/getcolor.glsl", "vec3 getColor() { return vec3(1,0,0); }\n");
+
+        auto spv = compiler.compile(src, EShLangFragment);
+        REQUIRE( cache->getStats().invalidated == 1);
+        REQUIRE( spv != reference );
+    }
+
+    glslang::FinalizeProcess();
+}
+
+#if defined(GNL_GLSL_HAS_MMAP)
+SCENARIO("Resolve includes from a pack archive")
+{
+    glslang::InitializeProcess();
+
+    auto src       = readSource(CMAKE_SOURCE_DIR "/data/fragmentShaderInclude.frag");
+    auto reference = gnl::GLSLCompiler::compileFromFile(CMAKE_SOURCE_DIR "/data/fragmentShaderInclude.frag", {CMAKE_SOURCE_DIR "/data/include"});
+
+    auto packPath = (std::filesystem::temp_directory_path() / "GLSLCompiler-unit-includer.pack").string();
+
+    gnl::GLSLMemoryBackend files;
+    files.addDirectory(CMAKE_SOURCE_DIR "/data/include", "include");
+    gnl::GLSLPackBackend::write(packPath, files.getFiles());
+
+    PackCompiler compiler;
+    compiler.getIncluder().getBackend().load(packPath);
+    compiler.addIncludePath("include");
+
+    REQUIRE( compiler.getIncluder().getBackend().size() == files.getFiles().size() );
+    REQUIRE( compiler.compile(src, EShLangFragment) == reference );
+
+    THEN("Invalid archives throw")
+    {
+        {
+            std::ofstream out(packPath, std::ios_base::binary | std::ios_base::trunc);
+            out << "not a pack file";
+        }
+        gnl::GLSLPackBackend pack;
+        REQUIRE_THROWS( pack.load(packPath) );
+    }
+
+    std::filesystem::remove(packPath);
+
+    glslang::FinalizeProcess();
+}
+#endif
@@ -0,0 +1,203 @@
+#include <catch2/catch.hpp>
+#include <GLSLShaderManifest.h>
+#include <filesystem>
+
+SCENARIO("Compile the shaders listed in a manifest")
+{
+    glslang::InitializeProcess();
+
+    auto dir = std::filesystem::temp_directory_path() / "GLSLCompiler-unit-manifest";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+
+    auto manifestPath = (dir / "shaders.manifest").string();
+    auto journalPath  = (dir / "shaders.journal").string();
+    {
+        std::ofstream out(manifestPath);
+        out << "# test manifest\n";
+        out << CMAKE_SOURCE_DIR "/data/vertexShader.vert output=vertex.spv\n";
+        out << "\n";
+        out << CMAKE_SOURCE_DIR "/data/fragmentShaderInclude.frag output=include.spv include=" CMAKE_SOURCE_DIR "/data/include\n";
+        out << CMAKE_SOURCE_DIR "/data/genBRDF.comp stage=comp output=compute.spv define=UNUSED_VALUE=1\n";
+    }
+
+    gnl::ShaderManifestCompiler<> M;
+    M.setJournal(journalPath);
+
+    auto p = M.compile(manifestPath);
+
+    REQUIRE( p.entries  == 3);
+    REQUIRE( p.compiled == 3);
+    REQUIRE( p.failed   == 0);
+
+    THEN("The output matches compiling the file directly")
+    {
+        std::ifstream in( (dir / "vertex.spv").string(), std::ios_base::binary);
+        std::string   bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+        auto spv = gnl::GLSLCompiler::compileFromFile(CMAKE_SOURCE_DIR "/data/vertexShader.vert");
+
+        REQUIRE( bytes.size() == spv.size() * sizeof(uint32_t) );
+        REQUIRE( std::memcmp(bytes.data(), spv.data(), bytes.size()) == 0 );
+    }
+
+    THEN("Running again with the journal skips all the entries")
+    {
+        auto p2 = M.compile(manifestPath);
+
+        REQUIRE( p2.entries  == 3);
+        REQUIRE( p2.skipped  == 3);
+        REQUIRE( p2.compiled == 0);
+    }
+
+    THEN("The journal holds one stamp per entry and does not grow between runs")
+    {
+        M.compile(manifestPath);
+        M.compile(manifestPath);
+
+        auto stamps = std::distance(std::filesystem::directory_iterator(journalPath), std::filesystem::directory_iterator());
+        REQUIRE( stamps == 3);
+    }
+
+    THEN("Corrupt stamps are ignored and the entries are recompiled")
+    {
+        for(auto & f : std::filesystem::directory_iterator(journalPath))
+            std::ofstream(f.path().string(), std::ios_base::trunc) << "zz 99999999999999999999\n\"unterminated";
+
+        auto p2 = M.compile(manifestPath);
+
+        REQUIRE( p2.compiled == 3);
+        REQUIRE( p2.failed   == 0);
+    }
+
+    THEN("Missing outputs are recompiled when resuming")
+    {
+        std::filesystem::remove(dir / "compute.spv");
+
+        auto p2 = M.compile(manifestPath);
+
+        REQUIRE( p2.skipped  == 2);
+        REQUIRE( p2.compiled == 1);
+        REQUIRE( std::filesystem::exists(dir / "compute.spv") );
+    }
+
+    std::filesystem::remove_all(dir);
+
+    glslang::FinalizeProcess();
+}
+
+SCENARIO("Changing a source or an included file recompiles the entry")
+{
+    glslang::InitializeProcess();
+
+    auto dir = std::filesystem::temp_directory_path() / "GLSLCompiler-unit-manifest-changed";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir / "src");
+
+    std::filesystem::copy_file(CMAKE_SOURCE_DIR "/data/vertexShader.vert", dir / "src" / "vertexShader.vert");
+    std::filesystem::copy_file(CMAKE_SOURCE_DIR "/data/fragmentShaderInclude.frag", dir / "src" / "fragmentShaderInclude.frag");
+    std::filesystem::copy(CMAKE_SOURCE_DIR "/data/include", dir / "src" / "include", std::filesystem::copy_options::recursive);
+
+    auto manifestPath = (dir / "src" / "shaders.manifest").string();
+    auto journalPath  = (dir / "shaders.journal").string();
+    {
+        std::ofstream out(manifestPath);
+        out << "vertexShader.vert\n";
+        out << "fragmentShaderInclude.frag include=include\n";
+    }
+
+    gnl::ShaderManifestCompiler<> M;
+    M.setJournal(journalPath);
+    M.setOutputDirectory( (dir / "build").string() );
+
+    auto p = M.compile(manifestPath);
+
+    REQUIRE( p.compiled == 2);
+    REQUIRE( std::filesystem::exists(dir / "build" / "vertexShader.vert.spv") );
+    REQUIRE( std::filesystem::exists(dir / "build" / "fragmentShaderInclude.frag.spv") );
+    REQUIRE( !std::filesystem::exists(dir / "src" / "vertexShader.vert.spv") );
+
+    THEN("Editing the source recompiles it")
+    {
+        std::ofstream( (dir / "src" / "vertexShader.vert").string(), std::ios_base::app) << "\n// edited\n";
+
+        auto p2 = M.compile(manifestPath);
+
+        REQUIRE( p2.compiled == 1);
+        REQUIRE( p2.skipped  == 1);
+    }
+
+    THEN("Editing an included file recompiles the shader which included it")
+    {
+        for(auto & f : std::filesystem::directory_iterator(dir / "src" / "include"))
+            std::ofstream(f.path().string(), std::ios_base::app) << "\n// edited\n";
+
+        auto p2 = M.compile(manifestPath);
+
+        REQUIRE( p2.compiled == 1);
+        REQUIRE( p2.skipped  == 1);
+    }
+
+    std::filesystem::remove_all(dir);
+
+    glslang::FinalizeProcess();
+}
+
+SCENARIO("Manifest lines with an empty input path are rejected")
+{
+    auto manifestPath = (std::filesystem::temp_directory_path() / "GLSLCompiler-unit-manifest-empty.manifest").string();
+    {
+        std::ofstream out(manifestPath);
+        out << "# comment\n";
+        out << "\"\" output=empty.spv\n";
+    }
+
+    gnl::ShaderManifestReader reader(manifestPath);
+    gnl::ShaderManifestEntry  entry;
+
+    REQUIRE_THROWS_WITH( reader.next(entry), Catch::Contains("Manifest line 2") );
+
+    std::filesystem::remove(manifestPath);
+}
+
+SCENARIO("Failed entries are reported and do not stop the build")
+{
+    glslang::InitializeProcess();
+
+    auto dir = std::filesystem::temp_directory_path() / "GLSLCompiler-unit-manifest-fail";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+
+    auto manifestPath = (dir / "shaders.manifest").string();
+    {
+        std::ofstream out(manifestPath);
+        out << "does_not_exist.frag\n";
+        out << CMAKE_SOURCE_DIR "/data/vertexShader.vert output=vertex.spv\n";
+    }
+
+    std::vector<size_t> failedLines;
+
+    using Compiler = gnl::ShaderManifestCompiler<>;
+    Compiler M;
+    M.setProgressCallback([&](Compiler::Progress const &, gnl::ShaderManifestEntry const & e, Compiler::Status s, std::string const &)
+    {
+        if( s == Compiler::Status::Failed)
+            failedLines.push_back(e.line);
+    });
+
+    auto p = M.compile(manifestPath);
+
+    REQUIRE( p.failed   == 1);
+    REQUIRE( p.compiled == 1);
+    REQUIRE( failedLines == std::vector<size_t>{1} );
+
+    THEN("Stopping on error throws")
+    {
+        M.setContinueOnError(false);
+        REQUIRE_THROWS( M.compile(manifestPath) );
+    }
+
+    std::filesystem::remove_all(dir);
+
+    glslang::FinalizeProcess();
+}
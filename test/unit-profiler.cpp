@@ -0,0 +1,125 @@
+#include <catch2/catch.hpp>
+#include <GLSLProfiler.h>
+
+static std::string readSource(std::string const & path)
+{
+    std::ifstream t(path);
+    return std::string((std::istreambuf_iterator<char>(t)), std::istreambuf_iterator<char>());
+}
+
+static bool endsWith(std::string const & s, std::string const & suffix)
+{
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+SCENARIO("Count SPIR-V instructions per function")
+{
+    auto op = [](uint32_t wordCount, uint32_t opcode) { return (wordCount << 16) | opcode; };
+
+    std::vector<unsigned int> spirv = { 0x07230203, 0x00010000, 0, 10, 0,
+                                        op(3, 5), 4, 0x6e69616d, // OpName %4 "main"
+                                        op(5, 54), 1, 4, 0, 2,   // OpFunction
+                                        op(2, 248), 5,           // OpLabel
+                                        op(1, 253),              // OpReturn
+                                        op(1, 56),               // OpFunctionEnd
+                                        op(5, 54), 1, 6, 0, 2,   // unnamed OpFunction
+                                        op(1, 56) };
+
+    auto counts = gnl::GLSLProfiler::countSpirvInstructions(spirv);
+
+    REQUIRE( counts.size() == 2);
+    REQUIRE( counts["main"] == 4);
+    REQUIRE( counts["%6"]   == 2);
+}
+
+SCENARIO("Profile a shader with an include")
+{
+    glslang::InitializeProcess();
+
+    auto profiler = std::make_shared<gnl::GLSLProfiler>();
+
+    gnl::GLSLCompiler compiler;
+    compiler.addIncludePath(CMAKE_SOURCE_DIR "/data/include");
+    compiler.setProfiler(profiler);
+
+    profiler->setSourceName("fragmentShaderInclude.frag");
+    auto spv = compiler.compile( readSource(CMAKE_SOURCE_DIR "/data/fragmentShaderInclude.frag"), EShLangFragment);
+
+    REQUIRE( spv.size() > 0);
+
+    THEN("The included file is recorded")
+    {
+        auto & files = profiler->getFileStats();
+
+        auto it = std::find_if(files.begin(), files.end(), [](auto & f) { return endsWith(f.first, "getcolor.glsl"); });
+        REQUIRE( it != files.end() );
+        REQUIRE( it->second.includeCount == 1);
+        REQUIRE( it->second.astNodes > 0);
+    }
+
+    THEN("The functions are recorded with their SPIR-V instruction counts")
+    {
+        auto & functions = profiler->getFunctionStats();
+
+        REQUIRE( functions.count("fragmentShaderInclude.frag:main(") == 1);
+        REQUIRE( functions.at("fragmentShaderInclude.frag:main(").spirvInstructions > 0);
+
+        auto it = std::find_if(functions.begin(), functions.end(), [](auto & f) { return endsWith(f.first, "getcolor.glsl:getColor("); });
+        REQUIRE( it != functions.end() );
+        REQUIRE( it->second.spirvInstructions > 0);
+    }
+
+    THEN("A chrome trace and a report can be written")
+    {
+        std::ostringstream trace;
+        profiler->writeChromeTrace(trace);
+        REQUIRE( trace.str().find("\"traceEvents\"") != std::string::npos );
+        REQUIRE( trace.str().find("\"cat\":\"include\"") != std::string::npos );
+
+        std::ostringstream report;
+        profiler->writeReport(report);
+        REQUIRE( report.str().find("getcolor.glsl") != std::string::npos );
+    }
+
+    glslang::FinalizeProcess();
+}
+
+SCENARIO("Profilers are told when preprocessing is skipped by the cache")
+{
+    glslang::InitializeProcess();
+
+    struct StageRecorder : public gnl::GLSLCompileProfiler
+    {
+        std::vector<std::string> stages;
+        size_t                   wrapped = 0;
+
+        glslang::TShader::Includer & wrapIncluder(glslang::TShader::Includer & includer) override
+        {
+            wrapped++;
+            return includer;
+        }
+        void stage(const char * name, clock::time_point, clock::time_point) override
+        {
+            stages.push_back(name);
+        }
+    };
+
+    auto recorder = std::make_shared<StageRecorder>();
+    auto src      = readSource(CMAKE_SOURCE_DIR "/data/fragmentShaderInclude.frag");
+
+    gnl::GLSLCompiler compiler;
+    compiler.addIncludePath(CMAKE_SOURCE_DIR "/data/include");
+    compiler.setPreprocessedCache( std::make_shared<gnl::GLSLPreprocessedCache>() );
+    compiler.setProfiler(recorder);
+
+    compiler.compile(src, EShLangFragment);
+    REQUIRE( recorder->wrapped == 1);
+    REQUIRE( recorder->stages.front() == "preprocess");
+
+    recorder->stages.clear();
+    compiler.compile(src, EShLangFragment);
+    REQUIRE( recorder->wrapped == 1);
+    REQUIRE( recorder->stages.front() == "preprocess (cached)");
+
+    glslang::FinalizeProcess();
+}
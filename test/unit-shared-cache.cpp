@@ -0,0 +1,175 @@
+#include <catch2/catch.hpp>
+#include <GLSLSharedCache.h>
+#include <sys/wait.h>
+
+static std::string readSource(std::string const & path)
+{
+    std::ifstream t(path);
+    return std::string((std::istreambuf_iterator<char>(t)), std::istreambuf_iterator<char>());
+}
+
+SCENARIO("Share compiled SPIR-V through a cache directory")
+{
+    glslang::InitializeProcess();
+
+    auto dir = (std::filesystem::temp_directory_path() / "GLSLCompiler-unit-shared-cache").string();
+    std::filesystem::remove_all(dir);
+
+    auto src = readSource(CMAKE_SOURCE_DIR "/data/fragmentShader.frag");
+
+    auto cache = std::make_shared<gnl::GLSLSharedCacheDirectory>(dir);
+
+    gnl::GLSLCompiler compiler;
+    compiler.setSpirvCache(cache);
+
+    auto first = compiler.compile(src, EShLangFragment);
+
+    REQUIRE( cache->getStats().stores == 1);
+
+    THEN("A second cache using the same directory loads the result")
+    {
+        auto cache2 = std::make_shared<gnl::GLSLSharedCacheDirectory>(dir);
+
+        gnl::GLSLCompiler compiler2;
+        compiler2.setSpirvCache(cache2);
+
+        REQUIRE( compiler2.compile(src, EShLangFragment) == first );
+        REQUIRE( cache2->getStats().hits   == 1);
+        REQUIRE( cache2->getStats().stores == 0);
+    }
+
+    THEN("A compiler with a different SPIR-V target does not use the entry")
+    {
+        gnl::GLSLCompiler1115 compiler2;
+        compiler2.setSpirvCache(cache);
+
+        compiler2.compile(src, EShLangFragment);
+        REQUIRE( cache->getStats().stores == 2);
+    }
+
+    THEN("Corrupt entries are treated as misses")
+    {
+        for(auto & d : std::filesystem::directory_iterator(dir))
+        {
+            if( d.path().extension() == ".spv" )
+                std::filesystem::resize_file(d.path(), 10);
+        }
+
+        REQUIRE( compiler.compile(src, EShLangFragment) == first );
+        REQUIRE( cache->getStats().stores == 2);
+    }
+
+    THEN("Trimming removes the least recently used entries")
+    {
+        gnl::GLSLCompiler1115 compiler2;
+        compiler2.setSpirvCache(cache);
+        compiler2.compile(src, EShLangFragment);
+
+        cache->trim(0);
+
+        REQUIRE( cache->getStats().trimmed == 2);
+        REQUIRE( std::filesystem::is_empty(dir) == false ); // lock files are kept until they are stale
+    }
+
+    std::filesystem::remove_all(dir);
+
+    glslang::FinalizeProcess();
+}
+
+SCENARIO("Trimming keeps the most recently used entries")
+{
+    auto dir = (std::filesystem::temp_directory_path() / "GLSLCompiler-unit-shared-cache-lru").string();
+    std::filesystem::remove_all(dir);
+
+    gnl::GLSLSharedCacheDirectory cache(dir);
+
+    std::vector<uint32_t> spirv = {0x07230203, 1, 2, 3};
+    cache.store(1, spirv);
+    cache.store(2, spirv);
+
+    auto older = std::filesystem::path(dir) / "0000000000000001.spv";
+    auto newer = std::filesystem::path(dir) / "0000000000000002.spv";
+    REQUIRE( std::filesystem::exists(older) );
+    REQUIRE( std::filesystem::exists(newer) );
+
+    // entry 1 was written before entry 2
+    auto now = std::filesystem::file_time_type::clock::now();
+    std::filesystem::last_write_time(older, now - std::chrono::minutes(20));
+    std::filesystem::last_write_time(newer, now - std::chrono::minutes(10));
+
+    // using entry 1 makes it the most recently used
+    std::vector<uint32_t> loaded;
+    REQUIRE( cache.load(1, loaded) );
+    REQUIRE( loaded == spirv );
+
+    cache.trim( static_cast<size_t>(std::filesystem::file_size(older)) );
+
+    REQUIRE( cache.getStats().trimmed == 1);
+    REQUIRE( std::filesystem::exists(older) );
+    REQUIRE( !std::filesystem::exists(newer) );
+
+    std::filesystem::remove_all(dir);
+}
+
+SCENARIO("Default built-in resources always hash to the same key")
+{
+    // build the second set in a frame which has dirtied the stack first
+    auto first  = gnl::GLSLCompiler::hashResources(gnl::GLSLCompiler::getDefaultTBuiltInResource(), 0);
+    auto second = []()
+    {
+        volatile unsigned char scratch[sizeof(TBuiltInResource) * 2];
+        for(auto & c : scratch)
+            c = 0xAB;
+        return gnl::GLSLCompiler::hashResources(gnl::GLSLCompiler::getDefaultTBuiltInResource(), 0);
+    }();
+
+    REQUIRE( first == second );
+}
+
+SCENARIO("Multiple processes compile a shader only once")
+{
+    glslang::InitializeProcess();
+
+    auto dir = (std::filesystem::temp_directory_path() / "GLSLCompiler-unit-shared-cache-processes").string();
+    std::filesystem::remove_all(dir);
+
+    auto src = readSource(CMAKE_SOURCE_DIR "/data/genBRDF.comp");
+
+    std::vector<pid_t> children;
+    for(int i=0; i < 8; i++)
+    {
+        pid_t pid = fork();
+        if( pid == 0 )
+        {
+            // each child returns the number of shaders it compiled
+            auto cache = std::make_shared<gnl::GLSLSharedCacheDirectory>(dir);
+            gnl::GLSLCompiler compiler;
+            compiler.setSpirvCache(cache);
+            try
+            {
+                compiler.compile(src, EShLangCompute);
+            }
+            catch (...)
+            {
+                _exit(100);
+            }
+            _exit( static_cast<int>(cache->getStats().stores) );
+        }
+        children.push_back(pid);
+    }
+
+    int totalCompiled = 0;
+    for(auto pid : children)
+    {
+        int status = 0;
+        waitpid(pid, &status, 0);
+        REQUIRE( WIFEXITED(status) );
+        totalCompiled += WEXITSTATUS(status);
+    }
+
+    REQUIRE( totalCompiled == 1);
+
+    std::filesystem::remove_all(dir);
+
+    glslang::FinalizeProcess();
+}